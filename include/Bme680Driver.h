@@ -0,0 +1,111 @@
+/*
+  Bme680Driver.h - Bosch BME680 forced mode measurements through the Adafruit library
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_BME680_DRIVER_H
+#define _DPSOFTWARE_BME680_DRIVER_H
+
+#include <Arduino.h>
+#include <Adafruit_BME680.h>
+#include "SensorDriver.h"
+
+// beginReading() triggers the measurement and returns when it will be ready, endReading() only reads it back.
+// The gas heater fires only on the measurements started gasPeriodMs apart, the others read temperature, humidity
+// and pressure only: they take a few ms and don't heat the sensor.
+class Bme680Driver : public SensorDriver {
+
+public:
+  Bme680Driver(Adafruit_BME680 &sensor, uint8_t address, unsigned long gasPeriodMs)
+    : sensor(sensor), address(address), gasPeriodMs(gasPeriodMs) {
+  }
+
+  const char *name() const override {
+    return "BME680";
+  }
+
+  uint8_t channels() const override {
+    return SENSOR_TEMPERATURE | SENSOR_HUMIDITY | SENSOR_PRESSURE | SENSOR_GAS_RESISTANCE;
+  }
+
+  bool begin() override {
+    transactions++;
+    if (!sensor.begin(address)) return false;
+    sensor.setTemperatureOversampling(BME680_OS_8X); // BME680_OS_1X/BME680_OS_8X
+    sensor.setHumidityOversampling(BME680_OS_2X); // BME680_OS_1X/BME680_OS_2X
+    sensor.setPressureOversampling(BME680_OS_4X); // BME680_OS_1X/BME680_OS_4X
+    sensor.setIIRFilterSize(BME680_FILTER_SIZE_0); // BME680_FILTER_SIZE_0/BME680_FILTER_SIZE_3
+    sensor.setGasHeater(320, 150); // 320*C for 150 ms
+    heaterOn = true;
+    return true;
+  }
+
+  bool start() override {
+    bool gasDue = !gasMeasured || millis() - gasStartedAt >= gasPeriodMs;
+    setGasHeater(gasDue);
+    transactions++;
+    readyAt = sensor.beginReading();
+    if (readyAt == 0) {
+      errors++;
+      return false;
+    }
+    measuringGas = gasDue;
+    if (gasDue) {
+      gasMeasured = true;
+      gasStartedAt = millis();
+    }
+    return true;
+  }
+
+  bool poll() override {
+    return (long) (millis() - readyAt) >= 0;
+  }
+
+  bool collect(SensorReading &reading) override {
+    transactions++;
+    if (!sensor.endReading()) {
+      errors++;
+      return false;
+    }
+    reading.channels = measuringGas ? channels() : channels() & ~SENSOR_GAS_RESISTANCE;
+    reading.temperature = sensor.temperature;
+    reading.humidity = sensor.humidity;
+    reading.pressure = sensor.pressure;
+    reading.gasResistance = measuringGas ? sensor.gas_resistance : 0;
+    return true;
+  }
+
+  // The gas reference needs the heater on every measurement
+  void setGasHeater(bool on) {
+    if (on == heaterOn) return;
+    transactions++;
+    sensor.setGasHeater(on ? 320 : 0, on ? 150 : 0);
+    heaterOn = on;
+  }
+
+private:
+  Adafruit_BME680 &sensor;
+  uint8_t address;
+  unsigned long gasPeriodMs;
+  unsigned long readyAt = 0;
+  bool heaterOn = false;
+  bool measuringGas = false;
+  bool gasMeasured = false;
+  unsigned long gasStartedAt = 0;
+};
+
+#endif
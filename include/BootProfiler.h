@@ -0,0 +1,62 @@
+/*
+  BootProfiler.h - Timestamps of the boot phases, published once the device is online
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_BOOT_PROFILER_H
+#define _DPSOFTWARE_BOOT_PROFILER_H
+
+#include <Arduino.h>
+
+// Every phase is recorded with the millis() of its end, phase names must be string literals
+class BootProfiler {
+
+public:
+  static const uint8_t MAX_PHASES = 12;
+
+  void mark(const char *phase) {
+    if (count == MAX_PHASES) return;
+    phases[count].name = phase;
+    phases[count].endedAt = millis();
+    count++;
+  }
+
+  uint8_t size() const {
+    return count;
+  }
+
+  const char *name(uint8_t index) const {
+    return phases[index].name;
+  }
+
+  unsigned long endedAt(uint8_t index) const {
+    return phases[index].endedAt;
+  }
+
+  bool published = false;
+
+private:
+  struct Phase {
+    const char *name;
+    unsigned long endedAt;
+  };
+
+  Phase phases[MAX_PHASES];
+  uint8_t count = 0;
+};
+
+#endif
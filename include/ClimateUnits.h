@@ -0,0 +1,213 @@
+/*
+  ClimateUnits.h - Registry of the IR climate units driven by the Smartostat
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_CLIMATE_UNITS_H
+#define _DPSOFTWARE_CLIMATE_UNITS_H
+
+#include <Arduino.h>
+#include <IRac.h>
+#include <IRutils.h>
+
+struct ClimateUnit {
+  static const uint8_t NAME_SIZE = 16;
+  char name[NAME_SIZE];
+  // state requested by the commands and state of the last transmitted frame
+  stdAc::state_t desired;
+  stdAc::state_t sent;
+  bool sentValid = false;
+  bool pending = false;
+  // power and safety commands are transmitted even if they don't change the last transmitted state
+  bool force = false;
+  unsigned long dueAt = 0;
+  // repeats of the last transmitted frame still to be sent by update()
+  uint8_t repeatsLeft = 0;
+};
+
+// Climate units are identified by the name used in their topics, each one has its own protocol and state cache.
+// Every unit shares the same IR led: frames and their repeats are transmitted by update(), one per call and
+// frameGapMs apart, so a frame never overlaps the previous one and the loop is never blocked by more than a frame.
+// send() transmits a single frame right away and leaves its repeats to update().
+class ClimateUnits {
+
+public:
+  static const uint8_t MAX_UNITS = 4;
+
+  ClimateUnits(IRac &irac, uint16_t frameGapMs, uint8_t repeats) : irac(irac), frameGapMs(frameGapMs), repeats(repeats) {
+  }
+
+  int8_t find(const char *name) const {
+    for (uint8_t i = 0; i < unitsCount; i++) {
+      if (strcmp(units[i].name, name) == 0) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  // Add a unit or change the protocol of an existing one, -1 if the registry is full or the protocol is unknown
+  int8_t add(const char *name, decode_type_t protocol, int16_t model) {
+    if (!IRac::isProtocolSupported(protocol) || strlen(name) == 0 || strlen(name) >= ClimateUnit::NAME_SIZE) {
+      return -1;
+    }
+    int8_t index = find(name);
+    if (index < 0) {
+      if (unitsCount == MAX_UNITS) {
+        return -1;
+      }
+      index = unitsCount++;
+      ClimateUnit &unit = units[index];
+      strcpy(unit.name, name);
+      IRac::initState(&unit.desired);
+      unit.desired.mode = stdAc::opmode_t::kCool;
+      unit.desired.degrees = 26;
+      unit.desired.fanspeed = stdAc::fanspeed_t::kLow;
+      unit.desired.swingv = stdAc::swingv_t::kOff;
+      unit.pending = false;
+      unit.force = false;
+    }
+    ClimateUnit &unit = units[index];
+    unit.desired.protocol = protocol;
+    unit.desired.model = model;
+    // the unit may be a different device now, don't diff against its previous frames
+    unit.sentValid = false;
+    unit.repeatsLeft = 0;
+    return index;
+  }
+
+  bool remove(const char *name) {
+    int8_t index = find(name);
+    if (index < 0) {
+      return false;
+    }
+    for (uint8_t i = index; i + 1 < unitsCount; i++) {
+      units[i] = units[i + 1];
+    }
+    unitsCount--;
+    if (nextUnit >= unitsCount) nextUnit = 0;
+    return true;
+  }
+
+  uint8_t size() const {
+    return unitsCount;
+  }
+
+  ClimateUnit &operator[](uint8_t index) {
+    return units[index];
+  }
+
+  // Transmit the desired state after delayMs, a new request for the same unit postpones and replaces it.
+  // A forced request stays forced until it's transmitted.
+  void schedule(uint8_t index, uint16_t delayMs, bool force = false) {
+    if (units[index].pending) framesCoalesced++;
+    units[index].pending = true;
+    units[index].force |= force;
+    units[index].dueAt = millis() + delayMs;
+  }
+
+  // True if update() has a unit to handle
+  bool due() const {
+    if (millis() - lastFrameAt < frameGapMs) {
+      return false;
+    }
+    for (uint8_t i = 0; i < unitsCount; i++) {
+      if (units[i].repeatsLeft > 0 || (units[i].pending && (long) (millis() - units[i].dueAt) >= 0)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Transmit at most one frame. Repeats go first, then the due units round robin.
+  // Returns the index of the unit whose new state has been handled, -1 if nothing was due or a repeat was sent.
+  // A desired state equal to the last transmitted one is not transmitted again.
+  int8_t update() {
+    if (millis() - lastFrameAt < frameGapMs) {
+      return -1;
+    }
+    for (uint8_t i = 0; i < unitsCount; i++) {
+      ClimateUnit &unit = units[i];
+      if (unit.repeatsLeft == 0) {
+        continue;
+      }
+      if (unit.pending && (long) (millis() - unit.dueAt) >= 0) {
+        // superseded by the new state about to be sent
+        unit.repeatsLeft = 0;
+        continue;
+      }
+      unit.repeatsLeft--;
+      // no toggles in a repeated frame, the previous state doesn't change it
+      irac.sendAc(unit.sent, &unit.sent);
+      framesSent++;
+      lastFrameAt = millis();
+      return -1;
+    }
+    for (uint8_t i = 0; i < unitsCount; i++) {
+      uint8_t index = (nextUnit + i) % unitsCount;
+      ClimateUnit &unit = units[index];
+      if (!unit.pending || (long) (millis() - unit.dueAt) < 0) {
+        continue;
+      }
+      nextUnit = (index + 1) % unitsCount;
+      send(index, unit.force);
+      return index;
+    }
+    return -1;
+  }
+
+  // Transmit the desired state right away, false if it's equal to the last transmitted one and not forced.
+  // IR is one way, the last transmitted state may not be the state of the unit (physical remote): power and safety
+  // commands are forced. The previous state is given to IRac so the vendors with toggle commands (swing, powerful)
+  // get the right frame, a forced frame is always sent as a power transition.
+  bool send(uint8_t index, bool force = false) {
+    ClimateUnit &unit = units[index];
+    unit.pending = false;
+    unit.force = false;
+    if (!force && unit.sentValid && !IRac::cmpStates(unit.desired, unit.sent)) {
+      framesSkipped++;
+      return false;
+    }
+    stdAc::state_t prev = unit.sent;
+    if (force) prev.power = !unit.desired.power;
+    const stdAc::state_t *previous = unit.sentValid ? &prev : nullptr;
+    irac.sendAc(unit.desired, previous);
+    framesSent++;
+    // absolute state protocols are repeated, a frame carrying a toggle is not because the repeat would undo it
+    bool toggles = IRac::cmpStates(IRac::handleToggles(unit.desired, previous), IRac::handleToggles(unit.desired, &unit.desired));
+    unit.repeatsLeft = toggles ? 0 : repeats;
+    unit.sent = unit.desired;
+    unit.sentValid = true;
+    lastFrameAt = millis();
+    return true;
+  }
+
+  uint32_t framesSent = 0;
+  uint32_t framesSkipped = 0;
+  uint32_t framesCoalesced = 0;
+
+private:
+  IRac &irac;
+  uint16_t frameGapMs;
+  uint8_t repeats;
+  ClimateUnit units[MAX_UNITS];
+  uint8_t unitsCount = 0;
+  uint8_t nextUnit = 0;
+  unsigned long lastFrameAt = 0;
+};
+
+#endif
@@ -0,0 +1,179 @@
+/*
+  CpuGovernor.h - CPU frequency scaling between idle, IR timing and busy phases
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_CPU_GOVERNOR_H
+#define _DPSOFTWARE_CPU_GOVERNOR_H
+
+#include <Arduino.h>
+#if defined(ESP8266)
+extern "C" {
+#include <user_interface.h>
+}
+#endif
+
+// The ESP8266 runs at 80 or 160 MHz, the IR library is timed best at 80 MHz there.
+// The ESP32 keeps the 80 MHz APB clock at every frequency >= 80 MHz, the bus peripherals are not affected.
+#if defined(ESP8266)
+#ifndef CPU_IDLE_MHZ
+#define CPU_IDLE_MHZ 80
+#endif
+#ifndef CPU_TIMING_MHZ
+#define CPU_TIMING_MHZ 80
+#endif
+#ifndef CPU_BOOST_MHZ
+#define CPU_BOOST_MHZ 160
+#endif
+#else
+#ifndef CPU_IDLE_MHZ
+#define CPU_IDLE_MHZ 80
+#endif
+#ifndef CPU_TIMING_MHZ
+#define CPU_TIMING_MHZ 240
+#endif
+#ifndef CPU_BOOST_MHZ
+#define CPU_BOOST_MHZ 240
+#endif
+#endif
+
+enum CpuLevel : uint8_t {
+  CPU_IDLE,
+  CPU_TIMING, // IR capture and transmit
+  CPU_BOOST,  // rendering and parsing
+  CPU_LEVELS
+};
+
+// The frequency is chosen once per loop by update(): timing while an IR capture or transmission is in progress,
+// boost until idleDelayMs after the last boost() request, idle otherwise. The time spent at each level is accounted.
+class CpuGovernor {
+
+public:
+  CpuGovernor(bool enabled, uint16_t idleDelayMs) : enabled(enabled), idleDelayMs(idleDelayMs) {
+  }
+
+  // Rendering or parsing is about to start
+  void boost() {
+    boostedAt = millis();
+    boosted = true;
+    if (level == CPU_IDLE) apply(CPU_BOOST);
+  }
+
+  // IR capture, active until it's stopped
+  void setCapturing(bool active) {
+    if (capturing == active) return;
+    capturing = active;
+    update();
+  }
+
+  void beginTransmit() {
+    transmitting++;
+    apply(CPU_TIMING);
+  }
+
+  void endTransmit() {
+    if (transmitting > 0) transmitting--;
+    update();
+  }
+
+  // Call it once per loop
+  void update() {
+    if (boosted && millis() - boostedAt >= idleDelayMs) boosted = false;
+    apply((capturing || transmitting > 0) ? CPU_TIMING : boosted ? CPU_BOOST : CPU_IDLE);
+  }
+
+  // Frequency of the current level, the boot frequency if scaling is disabled
+  uint16_t mhz() const {
+    return enabled ? levelMhz(level) : bootMhz();
+  }
+
+  static uint16_t levelMhz(CpuLevel value) {
+    const uint16_t frequencies[CPU_LEVELS] = {CPU_IDLE_MHZ, CPU_TIMING_MHZ, CPU_BOOST_MHZ};
+    return frequencies[value];
+  }
+
+  // Milliseconds spent at a level, up to now
+  uint32_t residency(CpuLevel value) const {
+    return residencyMs[value] + ((value == level) ? millis() - levelSince : 0);
+  }
+
+  static const char *levelName(CpuLevel value) {
+    const char *names[CPU_LEVELS] = {"idle", "timing", "boost"};
+    return names[value];
+  }
+
+  const bool enabled;
+  uint32_t switches = 0;
+
+private:
+  void apply(CpuLevel value) {
+    if (!enabled || value == level) return;
+    unsigned long now = millis();
+    residencyMs[level] += now - levelSince;
+    levelSince = now;
+    // levels sharing a frequency don't touch the clock
+    if (levelMhz(value) != levelMhz(level)) {
+      setMhz(levelMhz(value));
+      switches++;
+    }
+    level = value;
+  }
+
+  static void setMhz(uint16_t value) {
+#if defined(ESP8266)
+    system_update_cpu_freq(static_cast<uint8_t>(value));
+#else
+    setCpuFrequencyMhz(value);
+#endif
+  }
+
+  static uint16_t bootMhz() {
+#if defined(ESP8266)
+    return ESP.getCpuFreqMHz();
+#else
+    return getCpuFrequencyMhz();
+#endif
+  }
+
+  uint16_t idleDelayMs;
+  // the boot frequency is the boost one, see board_build.f_cpu
+  CpuLevel level = CPU_BOOST;
+  bool boosted = true;
+  bool capturing = false;
+  uint8_t transmitting = 0;
+  unsigned long boostedAt = 0;
+  unsigned long levelSince = 0;
+  uint32_t residencyMs[CPU_LEVELS] = {0, 0, 0};
+};
+
+// Transmits in a scope at the IR timing frequency
+class CpuTransmitScope {
+
+public:
+  explicit CpuTransmitScope(CpuGovernor &governor) : governor(governor) {
+    governor.beginTransmit();
+  }
+
+  ~CpuTransmitScope() {
+    governor.endTransmit();
+  }
+
+private:
+  CpuGovernor &governor;
+};
+
+#endif
@@ -0,0 +1,137 @@
+/*
+  DeviceMetrics.h - Counters exported on the /metrics endpoint in the Prometheus text format
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_DEVICE_METRICS_H
+#define _DPSOFTWARE_DEVICE_METRICS_H
+
+#include <Arduino.h>
+
+// Every counter is updated where the event happens, a scrape only formats them
+struct DeviceMetrics {
+  uint32_t loops = 0;
+  uint32_t loopsPerSecond = 0;
+  uint32_t i2cTransactions = 0;
+  uint32_t i2cErrors = 0;
+  uint32_t mqttReceived = 0;
+  uint32_t mqttPublished = 0;
+  uint32_t mqttConnections = 0;
+  uint32_t relayCycles = 0;
+  uint32_t sensorReads = 0;
+  uint32_t sensorReadMsSum = 0;
+  uint32_t sensorReadMsMax = 0;
+
+  // Call it once per loop
+  void loopTick() {
+    loops++;
+    unsigned long now = millis();
+    if (now - secondStart >= 1000) {
+      loopsPerSecond = (loops - loopsAtSecondStart) * 1000 / (now - secondStart);
+      loopsAtSecondStart = loops;
+      secondStart = now;
+    }
+  }
+
+  void sensorRead(uint32_t durationMs) {
+    sensorReads++;
+    sensorReadMsSum += durationMs;
+    if (durationMs > sensorReadMsMax) sensorReadMsMax = durationMs;
+  }
+
+private:
+  unsigned long secondStart = 0;
+  uint32_t loopsAtSecondStart = 0;
+};
+
+// Streams the Prometheus text exposition format through a small caller provided buffer:
+// when the next metric doesn't fit, the buffer is handed to the sink and reused.
+// A metric larger than the whole buffer is left out, finish() sends what is left.
+class MetricsPage {
+
+public:
+  typedef void (*Sink)(const char *text, size_t length);
+
+  MetricsPage(char *buffer, size_t size, const char *prefix, Sink sink)
+    : buffer(buffer), size(size), prefix(prefix), sink(sink) {
+    buffer[0] = '\0';
+  }
+
+  void counter(const char *name, const char *help, uint32_t value) {
+    metric(name, help, "counter", value);
+  }
+
+  void gauge(const char *name, const char *help, uint32_t value) {
+    metric(name, help, "gauge", value);
+  }
+
+  // A summary without quantiles, the rate of _sum over _count is the mean
+  void summary(const char *name, const char *help, uint32_t sum, uint32_t count) {
+    for (uint8_t attempt = 0; attempt < 2; attempt++) {
+      int written = snprintf(buffer + length, size - length,
+                             "# HELP %s%s %s\n# TYPE %s%s summary\n%s%s_sum %lu\n%s%s_count %lu\n",
+                             prefix, name, help, prefix, name, prefix, name, static_cast<unsigned long>(sum),
+                             prefix, name, static_cast<unsigned long>(count));
+      if (advance(written)) return;
+    }
+  }
+
+  // Send the buffered metrics, returns the bytes sent by the whole page
+  size_t finish() {
+    flush();
+    return sent;
+  }
+
+private:
+  void metric(const char *name, const char *help, const char *type, uint32_t value) {
+    for (uint8_t attempt = 0; attempt < 2; attempt++) {
+      int written = snprintf(buffer + length, size - length, "# HELP %s%s %s\n# TYPE %s%s %s\n%s%s %lu\n",
+                             prefix, name, help, prefix, name, type, prefix, name, static_cast<unsigned long>(value));
+      if (advance(written)) return;
+    }
+  }
+
+  // false if the metric has been truncated, it's retried once in an empty buffer
+  bool advance(int written) {
+    if (written < 0 || static_cast<size_t>(written) >= size - length) {
+      buffer[length] = '\0';
+      // a metric that doesn't fit an empty buffer is dropped as a whole
+      if (length == 0) return true;
+      flush();
+      return false;
+    }
+    length += written;
+    return true;
+  }
+
+  void flush() {
+    if (length == 0) return;
+    sink(buffer, length);
+    sent += length;
+    length = 0;
+    buffer[0] = '\0';
+  }
+
+  char *buffer;
+  size_t size;
+  const char *prefix;
+  Sink sink;
+  size_t length = 0;
+  size_t sent = 0;
+};
+
+#endif
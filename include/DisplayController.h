@@ -0,0 +1,173 @@
+/*
+  DisplayController.h - SSD1306 register shadow, only changed values reach the I2C bus
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_DISPLAY_CONTROLLER_H
+#define _DPSOFTWARE_DISPLAY_CONTROLLER_H
+
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+
+// The I2C bus is shared with the BME680, every command is a bus transaction.
+// The controller remembers what has been written to the panel and skips the commands that would not change it.
+class DisplayController {
+
+public:
+  explicit DisplayController(Adafruit_SSD1306 &display) : display(display) {
+  }
+
+  // Panel state is unknown after display.begin() or a panel reset
+  void invalidate() {
+    contrast = UNKNOWN;
+    precharge = UNKNOWN;
+    power = UNKNOWN;
+    rotation = UNKNOWN;
+    fading = false;
+    frameKnown = false;
+  }
+
+  void setContrast(uint8_t value) {
+    fading = false;
+    writeContrast(value);
+  }
+
+  // Move the contrast to value in durationMs, driven by update()
+  void fadeContrast(uint8_t value, uint16_t durationMs) {
+    if (contrast == UNKNOWN || durationMs == 0) {
+      setContrast(value);
+      return;
+    }
+    if ((fading && value == fadeTo) || (!fading && contrast == value)) return;
+    fadeFrom = contrast;
+    fadeTo = value;
+    fadeStart = millis();
+    fadeDuration = durationMs;
+    fading = true;
+  }
+
+  void setPrecharge(uint8_t value) {
+    if (precharge == value) {
+      commandsSkipped++;
+      return;
+    }
+    command(SSD1306_SETPRECHARGE);
+    command(value);
+    precharge = value;
+  }
+
+  void setPower(bool on) {
+    if (power == on) {
+      commandsSkipped++;
+      return;
+    }
+    command(on ? SSD1306_DISPLAYON : SSD1306_DISPLAYOFF);
+    power = on;
+  }
+
+  bool isOn() const {
+    return power != 0;
+  }
+
+  // Rotation is applied by the GFX library while drawing, no I2C command is needed
+  void setRotation(uint8_t value) {
+    if (rotation == value) return;
+    display.setRotation(value);
+    rotation = value;
+  }
+
+  // The panel has been written bypassing show(), e.g. by the bootstrapper pages, push the next frame anyway
+  void forgetFrame() {
+    frameKnown = false;
+  }
+
+  // Push the frame buffer to the panel, a frame equal to the last one pushed is skipped
+  void show() {
+    uint32_t fingerprint = frameFingerprint();
+    if (frameKnown && fingerprint == lastFrame) {
+      framesSkipped++;
+      return;
+    }
+    display.display();
+    lastFrame = fingerprint;
+    frameKnown = true;
+    framesSent++;
+  }
+
+  // Advance the contrast fading, call it once per loop
+  void update() {
+    if (!fading) return;
+    unsigned long elapsed = millis() - fadeStart;
+    if (elapsed >= fadeDuration) {
+      fading = false;
+      writeContrast(fadeTo);
+      return;
+    }
+    int16_t step = (static_cast<int16_t>(fadeTo) - fadeFrom) * static_cast<int32_t>(elapsed) / fadeDuration;
+    writeContrast(fadeFrom + step);
+  }
+
+  uint32_t commandsSent = 0;
+  uint32_t commandsSkipped = 0;
+  uint32_t framesSent = 0;
+  uint32_t framesSkipped = 0;
+
+private:
+  static const int16_t UNKNOWN = -1;
+
+  // 32 bit FNV-1a of the frame buffer
+  uint32_t frameFingerprint() {
+    const uint8_t *buffer = display.getBuffer();
+    uint16_t size = display.width() * ((display.height() + 7) / 8);
+    uint32_t hash = 2166136261UL;
+    for (uint16_t i = 0; i < size; i++) {
+      hash ^= buffer[i];
+      hash *= 16777619UL;
+    }
+    return hash;
+  }
+
+  void writeContrast(uint8_t value) {
+    if (contrast == value) {
+      commandsSkipped++;
+      return;
+    }
+    command(SSD1306_SETCONTRAST);
+    command(value);
+    contrast = value;
+  }
+
+  void command(uint8_t value) {
+    display.ssd1306_command(value);
+    commandsSent++;
+  }
+
+  Adafruit_SSD1306 &display;
+  int16_t contrast = UNKNOWN;
+  int16_t precharge = UNKNOWN;
+  int16_t power = UNKNOWN;
+  int16_t rotation = UNKNOWN;
+  bool fading = false;
+  int16_t fadeFrom = 0;
+  uint8_t fadeTo = 0;
+  unsigned long fadeStart = 0;
+  uint16_t fadeDuration = 0;
+  uint32_t lastFrame = 0;
+  bool frameKnown = false;
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+  DutyCycle.h - Runtime, cycles and heating degree-minutes of an on/off actuator
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_DUTY_CYCLE_H
+#define _DPSOFTWARE_DUTY_CYCLE_H
+
+#include <Arduino.h>
+
+// Every update is O(1): the running time is added on transitions and when settle() is called.
+// Today's counters are references to persisted values (see persistedStats), the hours are kept in RAM.
+class DutyCycle {
+
+public:
+  static const unsigned long HOUR_MS = 3600000UL;
+
+  struct Window {
+    float runtime = 0;       // seconds
+    uint32_t cycles = 0;     // off to on transitions
+    float degreeMinutes = 0; // °C × minutes below the target
+  };
+
+  DutyCycle(float &runtimeToday, float &cyclesToday, float &degreeMinutesToday)
+    : runtimeToday(runtimeToday), cyclesToday(cyclesToday), degreeMinutesToday(degreeMinutesToday) {
+  }
+
+  void set(bool on, unsigned long now) {
+    settle(now);
+    if (on && !running) {
+      cyclesToday += 1;
+      currentHour.cycles++;
+    }
+    running = on;
+  }
+
+  bool isRunning() const {
+    return running;
+  }
+
+  // Account the running time up to now, split at the end of every hour it crosses
+  void settle(unsigned long now) {
+    while (now - hourStart >= HOUR_MS) {
+      hourStart += HOUR_MS;
+      accumulate(hourStart);
+      lastHour = currentHour;
+      currentHour = Window();
+    }
+    accumulate(now);
+  }
+
+  // Integrate degrees (target - temperature, 0 when above the target) over the minutes since the previous call
+  void integrate(float degrees, unsigned long now) {
+    if (integratedAt != 0 && degrees > 0) {
+      float degreeMinutes = degrees * (now - integratedAt) / 60000.0f;
+      degreeMinutesToday += degreeMinutes;
+      currentHour.degreeMinutes += degreeMinutes;
+    }
+    integratedAt = now;
+  }
+
+  void newDay(unsigned long now) {
+    settle(now);
+    runtimeToday = 0;
+    cyclesToday = 0;
+    degreeMinutesToday = 0;
+  }
+
+  // Seconds, 0 without cycles
+  float averageCycle() const {
+    return (cyclesToday > 0) ? runtimeToday / cyclesToday : 0;
+  }
+
+  // Last complete hour
+  const Window &hour() const {
+    return lastHour;
+  }
+
+  float &runtimeToday;
+  float &cyclesToday;
+  float &degreeMinutesToday;
+
+private:
+  void accumulate(unsigned long until) {
+    if (running) {
+      float seconds = (until - lastSettle) / 1000.0f;
+      runtimeToday += seconds;
+      currentHour.runtime += seconds;
+    }
+    lastSettle = until;
+  }
+
+  bool running = false;
+  unsigned long lastSettle = 0;
+  unsigned long integratedAt = 0;
+  unsigned long hourStart = 0;
+  Window currentHour;
+  Window lastHour;
+};
+
+#endif
@@ -0,0 +1,76 @@
+/*
+  FixedQueue.h - Bounded FIFO queue with storage fixed at compile time
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_FIXED_QUEUE_H
+#define _DPSOFTWARE_FIXED_QUEUE_H
+
+#include <Arduino.h>
+#include <utility>
+
+template<typename T, uint8_t CAPACITY>
+class FixedQueue {
+
+public:
+  bool push(const T &item) {
+    if (count == CAPACITY) return false;
+    items[(head + count) % CAPACITY] = item;
+    count++;
+    return true;
+  }
+
+  bool push(T &&item) {
+    if (count == CAPACITY) return false;
+    items[(head + count) % CAPACITY] = std::move(item);
+    count++;
+    return true;
+  }
+
+  bool pop(T &item) {
+    if (count == 0) return false;
+    item = std::move(items[head]);
+    // release resources held by the slot (documents, topics)
+    items[head] = T();
+    head = (head + 1) % CAPACITY;
+    count--;
+    return true;
+  }
+
+  T &peek() {
+    return items[head];
+  }
+
+  bool empty() const {
+    return count == 0;
+  }
+
+  bool full() const {
+    return count == CAPACITY;
+  }
+
+  uint8_t size() const {
+    return count;
+  }
+
+private:
+  T items[CAPACITY];
+  uint8_t head = 0;
+  uint8_t count = 0;
+};
+
+#endif
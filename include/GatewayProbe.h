@@ -0,0 +1,137 @@
+/*
+  GatewayProbe.h - Non blocking ICMP keep alive with link quality diagnostics
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_GATEWAY_PROBE_H
+#define _DPSOFTWARE_GATEWAY_PROBE_H
+
+#include <Arduino.h>
+#include <lwip/raw.h>
+#include <lwip/icmp.h>
+#include <lwip/inet_chksum.h>
+#include <lwip/prot/ip4.h>
+
+// Keeps the device in the gateway ARP/routing table with an ICMP echo.
+// send() queues the echo request on a raw lwIP socket and returns, the reply is matched by the lwIP receive
+// callback and accounted by update() in a later loop. A request without reply within timeoutMs is lost.
+class GatewayProbe {
+
+public:
+  explicit GatewayProbe(uint16_t timeoutMs) : timeoutMs(timeoutMs) {
+  }
+
+  bool begin() {
+    if (pcb != nullptr) return true;
+    pcb = raw_new(IP_PROTO_ICMP);
+    if (pcb == nullptr) return false;
+    raw_recv(pcb, onReceive, this);
+    raw_bind(pcb, IP_ADDR_ANY);
+    return true;
+  }
+
+  // Send an echo request, a request still waiting for its reply is counted as lost
+  void send(const IPAddress &target) {
+    if (pcb == nullptr) return;
+    if (inFlight) {
+      inFlight = false;
+      lost++;
+    }
+    struct pbuf *p = pbuf_alloc(PBUF_IP, ECHO_SIZE, PBUF_RAM);
+    if (p == nullptr) return;
+    struct icmp_echo_hdr *echo = static_cast<struct icmp_echo_hdr *>(p->payload);
+    ICMPH_TYPE_SET(echo, ICMP_ECHO);
+    ICMPH_CODE_SET(echo, 0);
+    echo->id = PROBE_ID;
+    echo->seqno = lwip_htons(++seqno);
+    echo->chksum = 0;
+    echo->chksum = inet_chksum(echo, ECHO_SIZE);
+    ip_addr_t destination;
+    IP_ADDR4(&destination, target[0], target[1], target[2], target[3]);
+    sentAt = millis();
+    inFlight = true;
+    replied = false;
+    if (raw_sendto(pcb, p, &destination) == ERR_OK) {
+      sent++;
+    } else {
+      inFlight = false;
+      lost++;
+    }
+    pbuf_free(p);
+  }
+
+  // Account replies and timeouts, call it once per loop
+  void update() {
+    if (replied) {
+      replied = false;
+      received++;
+      if (received == 1 || lastRtt < minRtt) minRtt = lastRtt;
+      if (lastRtt > maxRtt) maxRtt = lastRtt;
+      // exponential moving average, 1/8 weight to the last sample
+      avgRtt = (received == 1) ? lastRtt : avgRtt + (static_cast<int32_t>(lastRtt) - static_cast<int32_t>(avgRtt)) / 8;
+    } else if (inFlight && millis() - sentAt > timeoutMs) {
+      inFlight = false;
+      lost++;
+    }
+  }
+
+  // Percentage of the completed requests without reply
+  float lossPercentage() const {
+    uint32_t completed = received + lost;
+    return (completed == 0) ? 0 : (lost * 100.0f) / completed;
+  }
+
+  uint32_t sent = 0;
+  uint32_t received = 0;
+  uint32_t lost = 0;
+  uint32_t lastRtt = 0;
+  uint32_t minRtt = 0;
+  uint32_t maxRtt = 0;
+  uint32_t avgRtt = 0;
+
+private:
+  static const uint16_t PROBE_ID = 0x5D50;
+  static const uint16_t ECHO_SIZE = sizeof(struct icmp_echo_hdr);
+
+  // lwIP context, only match the reply and leave the accounting to update()
+  static u8_t onReceive(void *arg, struct raw_pcb *, struct pbuf *p, const ip_addr_t *) {
+    GatewayProbe *probe = static_cast<GatewayProbe *>(arg);
+    const struct ip_hdr *ipHeader = static_cast<const struct ip_hdr *>(p->payload);
+    uint16_t headerLength = IPH_HL(ipHeader) * 4;
+    struct icmp_echo_hdr echo;
+    if (p->tot_len < headerLength + ECHO_SIZE || pbuf_copy_partial(p, &echo, ECHO_SIZE, headerLength) != ECHO_SIZE) {
+      return 0;
+    }
+    if (ICMPH_TYPE(&echo) != ICMP_ER || echo.id != PROBE_ID || !probe->inFlight || lwip_ntohs(echo.seqno) != probe->seqno) {
+      return 0;
+    }
+    probe->lastRtt = millis() - probe->sentAt;
+    probe->inFlight = false;
+    probe->replied = true;
+    pbuf_free(p);
+    return 1;
+  }
+
+  uint16_t timeoutMs;
+  struct raw_pcb *pcb = nullptr;
+  uint16_t seqno = 0;
+  unsigned long sentAt = 0;
+  volatile bool inFlight = false;
+  volatile bool replied = false;
+};
+
+#endif
@@ -0,0 +1,94 @@
+/*
+  HampelFilter.h - Streaming outlier rejection for the Smartostat sensor values
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_HAMPEL_FILTER_H
+#define _DPSOFTWARE_HAMPEL_FILTER_H
+
+#include <Arduino.h>
+
+// Hampel filter over the last WINDOW raw samples.
+// A sample farther than nSigmas * 1.4826 * MAD from the window median is an outlier and the median is returned
+// in its place. Raw samples always enter the window so a real step change is accepted after WINDOW / 2 samples.
+// minDeviation avoids flagging every change when the window is flat (MAD == 0).
+template<typename T, uint8_t WINDOW>
+class HampelFilter {
+
+public:
+  HampelFilter(T nSigmas, T minDeviation) : nSigmas(nSigmas), minDeviation(minDeviation) {
+  }
+
+  T filter(T sample) {
+    T result = sample;
+    if (size >= 3) {
+      T median = windowMedian();
+      T deviations[WINDOW];
+      for (uint8_t i = 0; i < size; i++) {
+        deviations[i] = abs(window[i] - median);
+      }
+      T threshold = nSigmas * 1.4826f * medianOf(deviations, size);
+      if (threshold < minDeviation) threshold = minDeviation;
+      if (abs(sample - median) > threshold) {
+        outliers++;
+        result = median;
+      }
+    }
+    window[head] = sample;
+    head = (head + 1) % WINDOW;
+    if (size < WINDOW) size++;
+    return result;
+  }
+
+  void reset() {
+    head = 0;
+    size = 0;
+  }
+
+  uint32_t outliers = 0;
+
+private:
+  T windowMedian() const {
+    T sorted[WINDOW];
+    for (uint8_t i = 0; i < size; i++) {
+      sorted[i] = window[i];
+    }
+    return medianOf(sorted, size);
+  }
+
+  // Insertion sort, WINDOW is a handful of values
+  static T medianOf(T *values, uint8_t count) {
+    for (uint8_t i = 1; i < count; i++) {
+      T value = values[i];
+      int8_t j = i - 1;
+      while (j >= 0 && values[j] > value) {
+        values[j + 1] = values[j];
+        j--;
+      }
+      values[j + 1] = value;
+    }
+    return (count % 2) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+  }
+
+  T nSigmas;
+  T minDeviation;
+  T window[WINDOW];
+  uint8_t head = 0;
+  uint8_t size = 0;
+};
+
+#endif
@@ -0,0 +1,457 @@
+/*
+  MqttPayloads.h - Typed MQTT payloads shared by the Smartostat and the Smartoled
+
+  GENERATED by schema/generate_payloads.py from schema/mqtt_payloads.json, DO NOT EDIT.
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_MQTT_PAYLOADS_H
+#define _DPSOFTWARE_MQTT_PAYLOADS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "PayloadCodec.h"
+
+struct SensorValues {
+  float temperature = 0;
+  float humidity = 0;
+  float pressure = 0;
+  float gasResistance = 0;
+  float iaq = 0;
+  // true once decoded from a message, optional objects are encoded only when true
+  bool present = false;
+};
+
+inline void encodeJson(PayloadWriter &writer, const SensorValues &value) {
+  writer.beginObject();
+  writer.key("Temperature");
+  writer.number(value.temperature, 1);
+  writer.key("Humidity");
+  writer.number(value.humidity, 1);
+  writer.key("Pressure");
+  writer.number(value.pressure, 1);
+  writer.key("GasResistance");
+  writer.number(value.gasResistance, 1);
+  writer.key("IAQ");
+  writer.number(value.iaq, 1);
+  writer.endObject();
+}
+
+inline uint8_t decodeJson(JsonObjectConst object, SensorValues &value) {
+  uint8_t decoded = 0;
+  for (JsonPairConst member : object) {
+    const char *key = member.key().c_str();
+    switch (member.key().size()) {
+      case 3:
+        if (strcmp(key, "IAQ") == 0) {
+          value.iaq = member.value().as<float>();
+          decoded++;
+        }
+        break;
+      case 8:
+        if (strcmp(key, "Humidity") == 0) {
+          value.humidity = member.value().as<float>();
+          decoded++;
+        } else if (strcmp(key, "Pressure") == 0) {
+          value.pressure = member.value().as<float>();
+          decoded++;
+        }
+        break;
+      case 11:
+        if (strcmp(key, "Temperature") == 0) {
+          value.temperature = member.value().as<float>();
+          decoded++;
+        }
+        break;
+      case 13:
+        if (strcmp(key, "GasResistance") == 0) {
+          value.gasResistance = member.value().as<float>();
+          decoded++;
+        }
+        break;
+    }
+  }
+  value.present = !object.isNull();
+  return decoded;
+}
+
+struct SensorBME680 {
+  float temperature = 0;
+  float humidity = 0;
+  float pressure = 0;
+  float gasResistance = 0;
+  float iaq = 0;
+  SensorValues min;
+  SensorValues max;
+  uint32_t samples = 0;
+  // true once decoded from a message, optional objects are encoded only when true
+  bool present = false;
+};
+
+inline void encodeJson(PayloadWriter &writer, const SensorBME680 &value) {
+  writer.beginObject();
+  writer.key("Temperature");
+  writer.number(value.temperature, 1);
+  writer.key("Humidity");
+  writer.number(value.humidity, 1);
+  writer.key("Pressure");
+  writer.number(value.pressure, 1);
+  writer.key("GasResistance");
+  writer.number(value.gasResistance, 1);
+  writer.key("IAQ");
+  writer.number(value.iaq, 1);
+  writer.key("Min");
+  encodeJson(writer, value.min);
+  writer.key("Max");
+  encodeJson(writer, value.max);
+  writer.key("Samples");
+  writer.number(value.samples);
+  writer.endObject();
+}
+
+inline uint8_t decodeJson(JsonObjectConst object, SensorBME680 &value) {
+  uint8_t decoded = 0;
+  for (JsonPairConst member : object) {
+    const char *key = member.key().c_str();
+    switch (member.key().size()) {
+      case 3:
+        if (strcmp(key, "IAQ") == 0) {
+          value.iaq = member.value().as<float>();
+          decoded++;
+        } else if (strcmp(key, "Min") == 0) {
+          decoded += decodeJson(member.value().as<JsonObjectConst>(), value.min);
+        } else if (strcmp(key, "Max") == 0) {
+          decoded += decodeJson(member.value().as<JsonObjectConst>(), value.max);
+        }
+        break;
+      case 7:
+        if (strcmp(key, "Samples") == 0) {
+          value.samples = member.value().as<uint32_t>();
+          decoded++;
+        }
+        break;
+      case 8:
+        if (strcmp(key, "Humidity") == 0) {
+          value.humidity = member.value().as<float>();
+          decoded++;
+        } else if (strcmp(key, "Pressure") == 0) {
+          value.pressure = member.value().as<float>();
+          decoded++;
+        }
+        break;
+      case 11:
+        if (strcmp(key, "Temperature") == 0) {
+          value.temperature = member.value().as<float>();
+          decoded++;
+        }
+        break;
+      case 13:
+        if (strcmp(key, "GasResistance") == 0) {
+          value.gasResistance = member.value().as<float>();
+          decoded++;
+        }
+        break;
+    }
+  }
+  value.present = !object.isNull();
+  return decoded;
+}
+
+struct SensorSCD4x {
+  float co2 = 0;
+  float temperature = 0;
+  float humidity = 0;
+  uint32_t samples = 0;
+  // true once decoded from a message, optional objects are encoded only when true
+  bool present = false;
+};
+
+inline void encodeJson(PayloadWriter &writer, const SensorSCD4x &value) {
+  writer.beginObject();
+  writer.key("CO2");
+  writer.number(value.co2, 0);
+  writer.key("Temperature");
+  writer.number(value.temperature, 1);
+  writer.key("Humidity");
+  writer.number(value.humidity, 1);
+  writer.key("Samples");
+  writer.number(value.samples);
+  writer.endObject();
+}
+
+inline uint8_t decodeJson(JsonObjectConst object, SensorSCD4x &value) {
+  uint8_t decoded = 0;
+  for (JsonPairConst member : object) {
+    const char *key = member.key().c_str();
+    switch (member.key().size()) {
+      case 3:
+        if (strcmp(key, "CO2") == 0) {
+          value.co2 = member.value().as<float>();
+          decoded++;
+        }
+        break;
+      case 7:
+        if (strcmp(key, "Samples") == 0) {
+          value.samples = member.value().as<uint32_t>();
+          decoded++;
+        }
+        break;
+      case 8:
+        if (strcmp(key, "Humidity") == 0) {
+          value.humidity = member.value().as<float>();
+          decoded++;
+        }
+        break;
+      case 11:
+        if (strcmp(key, "Temperature") == 0) {
+          value.temperature = member.value().as<float>();
+          decoded++;
+        }
+        break;
+    }
+  }
+  value.present = !object.isNull();
+  return decoded;
+}
+
+struct SensorState {
+  static const char *topic() {
+    return "tele/smartostat/SENSOR";
+  }
+
+  char time[33] = "";
+  char state[4] = "";
+  char power1[4] = "";
+  char power2[4] = "";
+  SensorBME680 bme680;
+  SensorSCD4x scd4x;
+  // true once decoded from a message, optional objects are encoded only when true
+  bool present = false;
+};
+
+inline void encodeJson(PayloadWriter &writer, const SensorState &value) {
+  writer.beginObject();
+  writer.key("Time");
+  writer.string(value.time);
+  writer.key("state");
+  writer.string(value.state);
+  writer.key("POWER1");
+  writer.string(value.power1);
+  writer.key("POWER2");
+  writer.string(value.power2);
+  if (value.bme680.present) {
+    writer.key("BME680");
+    encodeJson(writer, value.bme680);
+  }
+  if (value.scd4x.present) {
+    writer.key("SCD4x");
+    encodeJson(writer, value.scd4x);
+  }
+  writer.endObject();
+}
+
+inline uint8_t decodeJson(JsonObjectConst object, SensorState &value) {
+  uint8_t decoded = 0;
+  for (JsonPairConst member : object) {
+    const char *key = member.key().c_str();
+    switch (member.key().size()) {
+      case 4:
+        if (strcmp(key, "Time") == 0) {
+          decodeString(member.value(), value.time, sizeof(value.time));
+          decoded++;
+        }
+        break;
+      case 5:
+        if (strcmp(key, "state") == 0) {
+          decodeString(member.value(), value.state, sizeof(value.state));
+          decoded++;
+        } else if (strcmp(key, "SCD4x") == 0) {
+          decoded += decodeJson(member.value().as<JsonObjectConst>(), value.scd4x);
+        }
+        break;
+      case 6:
+        if (strcmp(key, "POWER1") == 0) {
+          decodeString(member.value(), value.power1, sizeof(value.power1));
+          decoded++;
+        } else if (strcmp(key, "POWER2") == 0) {
+          decodeString(member.value(), value.power2, sizeof(value.power2));
+          decoded++;
+        } else if (strcmp(key, "BME680") == 0) {
+          decoded += decodeJson(member.value().as<JsonObjectConst>(), value.bme680);
+        }
+        break;
+    }
+  }
+  value.present = !object.isNull();
+  return decoded;
+}
+
+struct ClimateEntity {
+  char hvacAction[12] = "";
+  float temperature = 0;
+  char presetMode[12] = "";
+  char alarmo[16] = "";
+  char fan[12] = "";
+  // true once decoded from a message, optional objects are encoded only when true
+  bool present = false;
+};
+
+inline void encodeJson(PayloadWriter &writer, const ClimateEntity &value) {
+  writer.beginObject();
+  writer.key("hvac_action");
+  writer.string(value.hvacAction);
+  writer.key("temperature");
+  writer.number(value.temperature, 1);
+  writer.key("preset_mode");
+  writer.string(value.presetMode);
+  writer.key("alarmo");
+  writer.string(value.alarmo);
+  writer.key("fan");
+  writer.string(value.fan);
+  writer.endObject();
+}
+
+inline uint8_t decodeJson(JsonObjectConst object, ClimateEntity &value) {
+  uint8_t decoded = 0;
+  for (JsonPairConst member : object) {
+    const char *key = member.key().c_str();
+    switch (member.key().size()) {
+      case 3:
+        if (strcmp(key, "fan") == 0) {
+          decodeString(member.value(), value.fan, sizeof(value.fan));
+          decoded++;
+        }
+        break;
+      case 6:
+        if (strcmp(key, "alarmo") == 0) {
+          decodeString(member.value(), value.alarmo, sizeof(value.alarmo));
+          decoded++;
+        }
+        break;
+      case 11:
+        if (strcmp(key, "hvac_action") == 0) {
+          decodeString(member.value(), value.hvacAction, sizeof(value.hvacAction));
+          decoded++;
+        } else if (strcmp(key, "temperature") == 0) {
+          value.temperature = member.value().as<float>();
+          decoded++;
+        } else if (strcmp(key, "preset_mode") == 0) {
+          decodeString(member.value(), value.presetMode, sizeof(value.presetMode));
+          decoded++;
+        }
+        break;
+    }
+  }
+  value.present = !object.isNull();
+  return decoded;
+}
+
+struct ClimateState {
+  static const char *topic() {
+    return "stat/smartostat/CLIMATE";
+  }
+
+  char time[33] = "";
+  char haVersion[16] = "";
+  float humidityThreshold = 0;
+  float tempSensorOffset = 0;
+  int32_t brightness = 0;
+  ClimateEntity smartostat;
+  ClimateEntity smartostatac;
+  // true once decoded from a message, optional objects are encoded only when true
+  bool present = false;
+};
+
+inline void encodeJson(PayloadWriter &writer, const ClimateState &value) {
+  writer.beginObject();
+  writer.key("Time");
+  writer.string(value.time);
+  writer.key("haVersion");
+  writer.string(value.haVersion);
+  writer.key("humidity_threshold");
+  writer.number(value.humidityThreshold, 1);
+  writer.key("temp_sensor_offset");
+  writer.number(value.tempSensorOffset, 1);
+  writer.key("brightness");
+  writer.number(value.brightness);
+  writer.key("smartostat");
+  encodeJson(writer, value.smartostat);
+  writer.key("smartostatac");
+  encodeJson(writer, value.smartostatac);
+  writer.endObject();
+}
+
+inline uint8_t decodeJson(JsonObjectConst object, ClimateState &value) {
+  uint8_t decoded = 0;
+  for (JsonPairConst member : object) {
+    const char *key = member.key().c_str();
+    switch (member.key().size()) {
+      case 4:
+        if (strcmp(key, "Time") == 0) {
+          decodeString(member.value(), value.time, sizeof(value.time));
+          decoded++;
+        }
+        break;
+      case 9:
+        if (strcmp(key, "haVersion") == 0) {
+          decodeString(member.value(), value.haVersion, sizeof(value.haVersion));
+          decoded++;
+        }
+        break;
+      case 10:
+        if (strcmp(key, "brightness") == 0) {
+          value.brightness = member.value().as<int32_t>();
+          decoded++;
+        } else if (strcmp(key, "smartostat") == 0) {
+          decoded += decodeJson(member.value().as<JsonObjectConst>(), value.smartostat);
+        }
+        break;
+      case 12:
+        if (strcmp(key, "smartostatac") == 0) {
+          decoded += decodeJson(member.value().as<JsonObjectConst>(), value.smartostatac);
+        }
+        break;
+      case 18:
+        if (strcmp(key, "humidity_threshold") == 0) {
+          value.humidityThreshold = member.value().as<float>();
+          decoded++;
+        } else if (strcmp(key, "temp_sensor_offset") == 0) {
+          value.tempSensorOffset = member.value().as<float>();
+          decoded++;
+        }
+        break;
+    }
+  }
+  value.present = !object.isNull();
+  return decoded;
+}
+
+// Encode the SensorState payload into buffer, returns its length or 0 if it does not fit
+inline size_t encodeJson(const SensorState &value, char *buffer, size_t size) {
+  PayloadWriter writer(buffer, size);
+  encodeJson(writer, value);
+  return writer.finish();
+}
+
+// Encode the ClimateState payload into buffer, returns its length or 0 if it does not fit
+inline size_t encodeJson(const ClimateState &value, char *buffer, size_t size) {
+  PayloadWriter writer(buffer, size);
+  encodeJson(writer, value);
+  return writer.finish();
+}
+
+#endif
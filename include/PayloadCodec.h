@@ -0,0 +1,127 @@
+/*
+  PayloadCodec.h - Building blocks of the generated MQTT payload encoders and decoders
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_PAYLOAD_CODEC_H
+#define _DPSOFTWARE_PAYLOAD_CODEC_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Writes JSON text straight into a caller provided buffer, nothing is allocated.
+// Once the buffer is full every write is ignored and finish() returns 0.
+class PayloadWriter {
+
+public:
+  PayloadWriter(char *buffer, size_t size) : buffer(buffer), size(size) {
+  }
+
+  void beginObject() {
+    append('{');
+    first = true;
+  }
+
+  void endObject() {
+    append('}');
+    first = false;
+  }
+
+  void key(const char *name) {
+    if (!first) append(',');
+    first = false;
+    string(name);
+    append(':');
+  }
+
+  void string(const char *value) {
+    append('"');
+    for (const char *c = value; *c; c++) {
+      if (*c == '"' || *c == '\\') append('\\');
+      append(*c);
+    }
+    append('"');
+  }
+
+  // nan and inf are not JSON, they are written as null
+  void number(float value, uint8_t decimals) {
+    if (!isfinite(value)) {
+      raw("null");
+      return;
+    }
+    // sign, 39 integer digits of the largest float, point and up to 6 decimals
+    char text[48];
+    dtostrf(value, 1, decimals > 6 ? 6 : decimals, text);
+    raw(text);
+  }
+
+  void number(int32_t value) {
+    char text[12];
+    ltoa(value, text, 10);
+    raw(text);
+  }
+
+  void number(uint32_t value) {
+    char text[12];
+    ultoa(value, text, 10);
+    raw(text);
+  }
+
+  void boolean(bool value) {
+    raw(value ? "true" : "false");
+  }
+
+  // Length of the payload, 0 if it did not fit
+  size_t finish() {
+    if (overflow || length >= size) return 0;
+    buffer[length] = '\0';
+    return length;
+  }
+
+private:
+  void raw(const char *text) {
+    while (*text) append(*text++);
+  }
+
+  void append(char c) {
+    // one byte is kept for the terminator
+    if (length + 1 >= size) {
+      overflow = true;
+      return;
+    }
+    buffer[length++] = c;
+  }
+
+  char *buffer;
+  size_t size;
+  size_t length = 0;
+  bool overflow = false;
+  bool first = true;
+};
+
+// Copy a string member into a fixed size field, numbers are copied as their JSON text
+inline void decodeString(JsonVariantConst value, char *field, size_t size) {
+  if (value.is<const char *>()) {
+    strlcpy(field, value.as<const char *>(), size);
+  } else if (value.isNull()) {
+    field[0] = '\0';
+  } else {
+    serializeJson(value, field, size);
+  }
+}
+
+#endif
@@ -0,0 +1,59 @@
+/*
+  PayloadSizeProbe.h - Full length of the MQTT payloads, including the ones that don't fit the PubSubClient buffer
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_PAYLOAD_SIZE_PROBE_H
+#define _DPSOFTWARE_PAYLOAD_SIZE_PROBE_H
+
+#include <Arduino.h>
+
+// PubSubClient silently ignores a PUBLISH larger than its buffer.
+// With a stream set (mqttClient.setStream()) it writes every payload byte to the stream and calls the callback
+// with the payload truncated to the buffer instead: the callback compares its length with take() to detect it.
+class PayloadSizeProbe : public Stream {
+
+public:
+  size_t write(uint8_t) override {
+    bytes++;
+    return 1;
+  }
+
+  int available() override {
+    return 0;
+  }
+
+  int read() override {
+    return -1;
+  }
+
+  int peek() override {
+    return -1;
+  }
+
+  // Payload bytes received since the last call
+  size_t take() {
+    size_t received = bytes;
+    bytes = 0;
+    return received;
+  }
+
+private:
+  size_t bytes = 0;
+};
+
+#endif
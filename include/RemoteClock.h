@@ -0,0 +1,77 @@
+/*
+  RemoteClock.h - Timer published by a remote device and advanced locally between its updates
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_REMOTE_CLOCK_H
+#define _DPSOFTWARE_REMOTE_CLOCK_H
+
+#include <Arduino.h>
+
+// Position (seconds) of a remote timer: every update resyncs it, millis() advances it while it is running.
+class RemoteClock {
+
+public:
+  // receivedAt is the millis() the position was read at, a message waiting in a queue is already late
+  void sync(float position, float duration, bool running, unsigned long receivedAt) {
+    syncedPosition = position;
+    syncedDuration = duration;
+    syncedAt = receivedAt;
+    this->running = running;
+    synced = true;
+  }
+
+  void clear() {
+    syncedPosition = 0;
+    syncedDuration = 0;
+    running = false;
+    synced = false;
+  }
+
+  bool isSynced() const {
+    return synced;
+  }
+
+  float duration() const {
+    return syncedDuration;
+  }
+
+  // Never past the duration, if known
+  float position() const {
+    float current = syncedPosition;
+    if (running) {
+      current += (millis() - syncedAt) / 1000.0f;
+    }
+    if (syncedDuration > 0 && current > syncedDuration) {
+      current = syncedDuration;
+    }
+    return current;
+  }
+
+  float remaining() const {
+    return syncedDuration - position();
+  }
+
+private:
+  float syncedPosition = 0;
+  float syncedDuration = 0;
+  unsigned long syncedAt = 0;
+  bool running = false;
+  bool synced = false;
+};
+
+#endif
@@ -0,0 +1,272 @@
+/*
+  RollingStats.h - Streaming statistics for the Smartostat sensor values
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_ROLLING_STATS_H
+#define _DPSOFTWARE_ROLLING_STATS_H
+
+#include <Arduino.h>
+
+// Welford running mean/variance, partitions can be merged (Chan et al.)
+template<typename T>
+struct Welford {
+  uint32_t count = 0;
+  T mean = 0;
+  T m2 = 0;
+
+  void add(T value) {
+    count++;
+    T delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+  }
+
+  void merge(const Welford &other) {
+    if (other.count == 0) return;
+    if (count == 0) {
+      *this = other;
+      return;
+    }
+    uint32_t total = count + other.count;
+    T delta = other.mean - mean;
+    mean += delta * other.count / total;
+    m2 += other.m2 + delta * delta * count * other.count / total;
+    count = total;
+  }
+
+  T variance() const {
+    return (count > 1) ? m2 / (count - 1) : 0;
+  }
+
+  T stddev() const {
+    return sqrt(variance());
+  }
+
+  void reset() {
+    count = 0;
+    mean = 0;
+    m2 = 0;
+  }
+};
+
+// An extreme value and the time (seconds) it has been seen
+template<typename T>
+struct Extreme {
+  T value = 0;
+  uint32_t timestamp = 0;
+};
+
+template<typename T>
+struct StatsBucket {
+  Welford<T> moments;
+  Extreme<T> min;
+  Extreme<T> max;
+
+  void add(T value, uint32_t now) {
+    if (moments.count == 0 || value < min.value) min = {value, now};
+    if (moments.count == 0 || value > max.value) max = {value, now};
+    moments.add(value);
+  }
+
+  void reset() {
+    moments.reset();
+  }
+};
+
+// Sliding window of BUCKETS * bucketSeconds seconds.
+// Samples are aggregated in the open bucket, closed buckets are kept in a ring together with two monotonic
+// deques of ring slots (increasing mins, decreasing maxs) so the window extremes are always at the
+// deque fronts. Every sample costs O(1) amortized, memory is fixed at compile time.
+// The window slides with the granularity of one bucket.
+template<typename T, uint8_t BUCKETS>
+class RollingWindow {
+
+public:
+  explicit RollingWindow(uint32_t bucketSeconds) : bucketSeconds(bucketSeconds) {
+  }
+
+  void add(T value, uint32_t now) {
+    advance(now);
+    open.add(value, now);
+  }
+
+  // Close the buckets that are over, call it before reading if samples may have stopped
+  void advance(uint32_t now) {
+    if (!started) {
+      openStart = now - (now % bucketSeconds);
+      started = true;
+      return;
+    }
+    if (now - openStart < bucketSeconds) return;
+    uint32_t elapsedBuckets = (now - openStart) / bucketSeconds;
+    if (elapsedBuckets > BUCKETS) {
+      // nothing from the previous window survives a gap this long
+      clear();
+      openStart = now - (now % bucketSeconds);
+      started = true;
+      return;
+    }
+    for (uint32_t i = 0; i < elapsedBuckets; i++) {
+      closeOpenBucket();
+    }
+  }
+
+  bool empty() const {
+    return moments().count == 0;
+  }
+
+  Welford<T> moments() const {
+    Welford<T> total = closedMoments;
+    total.merge(open.moments);
+    return total;
+  }
+
+  Extreme<T> min() const {
+    Extreme<T> result = open.min;
+    bool found = open.moments.count > 0;
+    if (minSize > 0) {
+      const Extreme<T> &closed = bucketAt(minDeque[minHead]).min;
+      if (!found || closed.value <= result.value) result = closed;
+    }
+    return result;
+  }
+
+  Extreme<T> max() const {
+    Extreme<T> result = open.max;
+    bool found = open.moments.count > 0;
+    if (maxSize > 0) {
+      const Extreme<T> &closed = bucketAt(maxDeque[maxHead]).max;
+      if (!found || closed.value >= result.value) result = closed;
+    }
+    return result;
+  }
+
+  void clear() {
+    open.reset();
+    closedMoments.reset();
+    ringHead = 0;
+    closedCount = 0;
+    minHead = minSize = 0;
+    maxHead = maxSize = 0;
+    started = false;
+  }
+
+private:
+  const StatsBucket<T> &bucketAt(uint8_t slot) const {
+    return ring[slot];
+  }
+
+  void closeOpenBucket() {
+    if (closedCount == BUCKETS) {
+      evictOldest();
+    }
+    uint8_t slot = (ringHead + closedCount) % BUCKETS;
+    ring[slot] = open;
+    closedCount++;
+    if (open.moments.count > 0) {
+      closedMoments.merge(open.moments);
+      while (minSize > 0 && bucketAt(minDeque[(minHead + minSize - 1) % BUCKETS]).min.value >= open.min.value) {
+        minSize--;
+      }
+      minDeque[(minHead + minSize++) % BUCKETS] = slot;
+      while (maxSize > 0 && bucketAt(maxDeque[(maxHead + maxSize - 1) % BUCKETS]).max.value <= open.max.value) {
+        maxSize--;
+      }
+      maxDeque[(maxHead + maxSize++) % BUCKETS] = slot;
+    }
+    open.reset();
+    openStart += bucketSeconds;
+  }
+
+  void evictOldest() {
+    // deques are ordered by age, the oldest bucket can only be at their fronts
+    if (minSize > 0 && minDeque[minHead] == ringHead) {
+      minHead = (minHead + 1) % BUCKETS;
+      minSize--;
+    }
+    if (maxSize > 0 && maxDeque[maxHead] == ringHead) {
+      maxHead = (maxHead + 1) % BUCKETS;
+      maxSize--;
+    }
+    ringHead = (ringHead + 1) % BUCKETS;
+    closedCount--;
+    // merged again from the buckets left, subtracting the oldest one would accumulate the rounding errors forever
+    closedMoments.reset();
+    for (uint8_t i = 0; i < closedCount; i++) {
+      closedMoments.merge(bucketAt((ringHead + i) % BUCKETS).moments);
+    }
+  }
+
+  uint32_t bucketSeconds;
+  uint32_t openStart = 0;
+  bool started = false;
+  StatsBucket<T> open;
+  StatsBucket<T> ring[BUCKETS];
+  uint8_t ringHead = 0;
+  uint8_t closedCount = 0;
+  Welford<T> closedMoments;
+  uint8_t minDeque[BUCKETS];
+  uint8_t minHead = 0;
+  uint8_t minSize = 0;
+  uint8_t maxDeque[BUCKETS];
+  uint8_t maxHead = 0;
+  uint8_t maxSize = 0;
+};
+
+// Statistics of a single sensor value: min/max since the last reset plus the 1h, 24h and 7d rolling windows.
+// Longer windows use coarser buckets, the week slides one day at a time.
+template<typename T>
+class SensorStatistics {
+
+public:
+  static const uint8_t HOUR_BUCKETS = 6;   // 10 minutes each
+  static const uint8_t DAY_BUCKETS = 24;   // 1 hour each
+  static const uint8_t WEEK_BUCKETS = 7;   // 1 day each
+
+  SensorStatistics(T &minSinceReset, T &maxSinceReset)
+    : minSinceReset(minSinceReset), maxSinceReset(maxSinceReset), hour(600), day(3600), week(86400) {
+  }
+
+  void add(T value, uint32_t now) {
+    if (value < minSinceReset) minSinceReset = value;
+    if (value > maxSinceReset) maxSinceReset = value;
+    hour.add(value, now);
+    day.add(value, now);
+    week.add(value, now);
+  }
+
+  void advance(uint32_t now) {
+    hour.advance(now);
+    day.advance(now);
+    week.advance(now);
+  }
+
+  void clear() {
+    hour.clear();
+    day.clear();
+    week.clear();
+  }
+
+  T &minSinceReset;
+  T &maxSinceReset;
+  RollingWindow<T, HOUR_BUCKETS> hour;
+  RollingWindow<T, DAY_BUCKETS> day;
+  RollingWindow<T, WEEK_BUCKETS> week;
+};
+
+#endif
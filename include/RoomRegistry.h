@@ -0,0 +1,123 @@
+/*
+  RoomRegistry.h - State of the smartostats shown by the smartoled, looked up by the device level of their topics
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_ROOM_REGISTRY_H
+#define _DPSOFTWARE_ROOM_REGISTRY_H
+
+#include <Arduino.h>
+
+struct Room {
+  static const uint8_t NAME_SIZE = 24;
+  char name[NAME_SIZE] = "";
+  float temperature = -100.0f;
+  float humidity = -100.0f;
+  bool furnanceOn = false;
+  unsigned long updatedAt = 0;
+};
+
+// Rooms are registered once at boot, a topic like tele/<room>/SENSOR is mapped to its slot through an open
+// addressing hash table of the room names: the lookup is O(1) and nothing is allocated.
+template<uint8_t CAPACITY>
+class RoomRegistry {
+
+public:
+  static const uint8_t NOT_FOUND = 0xFF;
+
+  RoomRegistry() {
+    memset(table, 0, sizeof(table));
+  }
+
+  // Index of the new room, NOT_FOUND if the registry is full or the name is empty or too long
+  uint8_t add(const char *name, size_t length) {
+    if (length == 0 || length >= Room::NAME_SIZE || count == CAPACITY) return NOT_FOUND;
+    uint8_t existing = find(name, length);
+    if (existing != NOT_FOUND) return existing;
+    memcpy(rooms[count].name, name, length);
+    rooms[count].name[length] = '\0';
+    uint8_t bucket = hash(name, length) & (TABLE_SIZE - 1);
+    while (table[bucket] != 0) bucket = (bucket + 1) & (TABLE_SIZE - 1);
+    table[bucket] = count + 1;
+    return count++;
+  }
+
+  // Register a comma separated list of room names
+  void addList(const char *names) {
+    const char *start = names;
+    for (const char *c = names;; c++) {
+      if (*c == ',' || *c == '\0') {
+        add(start, c - start);
+        if (*c == '\0') return;
+        start = c + 1;
+      }
+    }
+  }
+
+  // Room of a <prefix>/<room>/<suffix> topic
+  Room *findTopic(const char *topic) {
+    const char *start = strchr(topic, '/');
+    if (start == nullptr) return nullptr;
+    start++;
+    const char *end = strchr(start, '/');
+    size_t length = (end == nullptr) ? strlen(start) : end - start;
+    uint8_t index = find(start, length);
+    return (index == NOT_FOUND) ? nullptr : &rooms[index];
+  }
+
+  uint8_t size() const {
+    return count;
+  }
+
+  Room &operator[](uint8_t index) {
+    return rooms[index];
+  }
+
+private:
+  // power of two with at least half of the buckets empty
+  static const uint8_t TABLE_SIZE = (CAPACITY <= 2) ? 4 : (CAPACITY <= 4) ? 8 : (CAPACITY <= 8) ? 16 : 32;
+  static_assert(CAPACITY <= 16, "RoomRegistry supports up to 16 rooms");
+
+  uint8_t find(const char *name, size_t length) const {
+    if (length >= Room::NAME_SIZE) return NOT_FOUND;
+    uint8_t bucket = hash(name, length) & (TABLE_SIZE - 1);
+    while (table[bucket] != 0) {
+      const Room &room = rooms[table[bucket] - 1];
+      if (strncmp(room.name, name, length) == 0 && room.name[length] == '\0') {
+        return table[bucket] - 1;
+      }
+      bucket = (bucket + 1) & (TABLE_SIZE - 1);
+    }
+    return NOT_FOUND;
+  }
+
+  // 32 bit FNV-1a
+  static uint32_t hash(const char *name, size_t length) {
+    uint32_t value = 2166136261UL;
+    for (size_t i = 0; i < length; i++) {
+      value ^= static_cast<uint8_t>(name[i]);
+      value *= 16777619UL;
+    }
+    return value;
+  }
+
+  Room rooms[CAPACITY];
+  uint8_t table[TABLE_SIZE];
+  uint8_t count = 0;
+};
+
+#endif
@@ -0,0 +1,135 @@
+/*
+  Scd4xDriver.h - Sensirion SCD40/SCD41 CO2 sensor, low power periodic measurements over I2C
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_SCD4X_DRIVER_H
+#define _DPSOFTWARE_SCD4X_DRIVER_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "SensorDriver.h"
+
+// The sensor measures on its own every 30 seconds, start() only arms the driver and poll() asks the sensor
+// if a new measurement is ready at most once per POLL_INTERVAL. Every command is a short I2C transaction,
+// the 1 ms execution time of the commands is the only wait.
+class Scd4xDriver : public SensorDriver {
+
+public:
+  static const uint8_t ADDRESS = 0x62;
+  static const unsigned long POLL_INTERVAL = 1000;
+
+  explicit Scd4xDriver(TwoWire &wire) : wire(wire) {
+  }
+
+  const char *name() const override {
+    return "SCD4x";
+  }
+
+  uint8_t channels() const override {
+    return SENSOR_TEMPERATURE | SENSOR_HUMIDITY | SENSOR_CO2;
+  }
+
+  // Called once from setup(), the sensor needs 500 ms to stop a measurement left running by a previous boot
+  bool begin() override {
+    wire.beginTransmission(ADDRESS);
+    transactions++;
+    if (wire.endTransmission() != 0) return false;
+    if (!command(STOP_PERIODIC_MEASUREMENT)) return false;
+    delay(500);
+    return command(START_LOW_POWER_PERIODIC_MEASUREMENT);
+  }
+
+  bool start() override {
+    lastPoll = 0;
+    return true;
+  }
+
+  bool poll() override {
+    if (lastPoll != 0 && millis() - lastPoll < POLL_INTERVAL) return false;
+    lastPoll = millis();
+    uint16_t status;
+    if (!read(GET_DATA_READY_STATUS, &status, 1)) return false;
+    // the 11 least significant bits are 0 when no measurement is ready
+    return (status & 0x07FF) != 0;
+  }
+
+  bool collect(SensorReading &reading) override {
+    uint16_t words[3];
+    if (!read(READ_MEASUREMENT, words, 3)) return false;
+    reading.channels = channels();
+    reading.co2 = words[0];
+    reading.temperature = -45.0f + 175.0f * words[1] / 65535.0f;
+    reading.humidity = 100.0f * words[2] / 65535.0f;
+    return true;
+  }
+
+private:
+  static const uint16_t START_LOW_POWER_PERIODIC_MEASUREMENT = 0x21AC;
+  static const uint16_t STOP_PERIODIC_MEASUREMENT = 0x3F86;
+  static const uint16_t GET_DATA_READY_STATUS = 0xE4B8;
+  static const uint16_t READ_MEASUREMENT = 0xEC05;
+
+  bool command(uint16_t code) {
+    wire.beginTransmission(ADDRESS);
+    wire.write(code >> 8);
+    wire.write(code & 0xFF);
+    transactions++;
+    if (wire.endTransmission() != 0) {
+      errors++;
+      return false;
+    }
+    return true;
+  }
+
+  // Every word is followed by its CRC
+  bool read(uint16_t code, uint16_t *words, uint8_t count) {
+    if (!command(code)) return false;
+    delay(1);
+    transactions++;
+    if (wire.requestFrom(ADDRESS, static_cast<uint8_t>(count * 3)) != count * 3) {
+      errors++;
+      return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+      uint8_t data[2] = {static_cast<uint8_t>(wire.read()), static_cast<uint8_t>(wire.read())};
+      if (crc8(data) != wire.read()) {
+        errors++;
+        return false;
+      }
+      words[i] = (data[0] << 8) | data[1];
+    }
+    return true;
+  }
+
+  // CRC-8, polynomial 0x31, initialization 0xFF
+  static uint8_t crc8(const uint8_t *data) {
+    uint8_t crc = 0xFF;
+    for (uint8_t i = 0; i < 2; i++) {
+      crc ^= data[i];
+      for (uint8_t bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  TwoWire &wire;
+  unsigned long lastPoll = 0;
+};
+
+#endif
@@ -0,0 +1,79 @@
+/*
+  SensorDriver.h - Asynchronous sensor drivers sharing the I2C bus
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_SENSOR_DRIVER_H
+#define _DPSOFTWARE_SENSOR_DRIVER_H
+
+#include <Arduino.h>
+
+enum SensorChannel : uint8_t {
+  SENSOR_TEMPERATURE = 1 << 0,    // °C
+  SENSOR_HUMIDITY = 1 << 1,       // %
+  SENSOR_PRESSURE = 1 << 2,       // Pa
+  SENSOR_GAS_RESISTANCE = 1 << 3, // ohm
+  SENSOR_CO2 = 1 << 4,            // ppm
+};
+
+struct SensorReading {
+  uint8_t channels = 0;
+  float temperature = 0;
+  float humidity = 0;
+  float pressure = 0;
+  float gasResistance = 0;
+  float co2 = 0;
+
+  bool has(SensorChannel channel) const {
+    return (channels & channel) != 0;
+  }
+};
+
+// A measurement is started, polled from the main loop until it's ready and then collected,
+// no call waits for the sensor. Bus transactions and errors are counted by the drivers.
+class SensorDriver {
+
+public:
+  virtual ~SensorDriver() = default;
+
+  virtual const char *name() const = 0;
+
+  // Channels the sensor measures
+  virtual uint8_t channels() const = 0;
+
+  // Detect and configure the sensor, false if it's not on the bus
+  virtual bool begin() = 0;
+
+  // Start a measurement, false on a bus error
+  virtual bool start() = 0;
+
+  // True once the measurement can be collected
+  virtual bool poll() = 0;
+
+  // Read the measurement, false on a bus error
+  virtual bool collect(SensorReading &reading) = 0;
+
+  bool present = false;
+  bool pending = false;
+  unsigned long startedAt = 0;
+  // channels taken from this sensor, the first present driver measuring a channel owns it
+  uint8_t owned = 0;
+  uint32_t transactions = 0;
+  uint32_t errors = 0;
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*
+  SerialTrace.h - Binary profiling frames streamed over the serial port, decoded by tools/serial_trace.py
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_SERIAL_TRACE_H
+#define _DPSOFTWARE_SERIAL_TRACE_H
+
+#include <Arduino.h>
+
+// Frame layout, little endian:
+//   0xA5 0x5A | type u8 | length u8 | sequence u16 | micros u32 | payload (length bytes) | CRC-16/CCITT-FALSE u16
+// The CRC covers everything between the sync bytes and the CRC. Text printed on the same port is skipped by the
+// decoder, it resynchronizes on the sync bytes and the CRC.
+// A frame that doesn't fit in the serial TX buffer is dropped instead of blocking the loop, the decoder sees the
+// gap in the sequence numbers.
+enum SerialTraceType : uint8_t {
+  TRACE_LOOP = 1,      // u32 duration of the previous loop in us
+  TRACE_SENSOR = 2,    // f32 temperature C, f32 humidity %, f32 pressure Pa, u32 gas resistance ohm (0 without gas measurement), raw BME680 values
+  TRACE_EDGE = 3,      // u8 pin, u8 level
+  TRACE_MQTT_IN = 4,   // u16 payload length, topic
+  TRACE_MQTT_OUT = 5,  // u16 payload length, topic
+  TRACE_CO2 = 6,       // f32 CO2 ppm, f32 temperature C, f32 humidity %, raw SCD4x values
+};
+
+class SerialTrace {
+
+public:
+  static const uint8_t MAX_PAYLOAD = 48;
+  static const uint8_t MAX_PINS = 4;
+
+  explicit SerialTrace(Stream &port) : port(port) {
+  }
+
+  bool enabled = false;
+  uint32_t framesDropped = 0;
+
+  // Call it once at the beginning of loop(), traces the duration of the previous iteration
+  void loop() {
+    if (!enabled) return;
+    unsigned long now = micros();
+    if (loopStart != 0) {
+      uint8_t payload[4];
+      put32(payload, now - loopStart);
+      frame(TRACE_LOOP, payload, sizeof(payload));
+    }
+    loopStart = now;
+  }
+
+  void sensor(float temperature, float humidity, float pressure, uint32_t gasResistance) {
+    if (!enabled) return;
+    uint8_t payload[16];
+    putFloat(payload, temperature);
+    putFloat(payload + 4, humidity);
+    putFloat(payload + 8, pressure);
+    put32(payload + 12, gasResistance);
+    frame(TRACE_SENSOR, payload, sizeof(payload));
+  }
+
+  void co2(float co2, float temperature, float humidity) {
+    if (!enabled) return;
+    uint8_t payload[12];
+    putFloat(payload, co2);
+    putFloat(payload + 4, temperature);
+    putFloat(payload + 8, humidity);
+    frame(TRACE_CO2, payload, sizeof(payload));
+  }
+
+  // Call it with the level read on every poll, only the changes are traced
+  void level(uint8_t pin, uint8_t value) {
+    if (!enabled) return;
+    uint8_t slot = 0;
+    while (slot < pinCount && pins[slot] != pin) slot++;
+    if (slot == pinCount) {
+      if (pinCount == MAX_PINS) return;
+      pins[pinCount++] = pin;
+    } else if (levels[slot] == value) {
+      return;
+    }
+    levels[slot] = value;
+    uint8_t payload[2] = {pin, value};
+    frame(TRACE_EDGE, payload, sizeof(payload));
+  }
+
+  void mqtt(SerialTraceType type, const char *topic, unsigned int length) {
+    if (!enabled) return;
+    uint8_t payload[MAX_PAYLOAD];
+    payload[0] = length & 0xFF;
+    payload[1] = length >> 8;
+    size_t topicLength = strnlen(topic, MAX_PAYLOAD - 2);
+    memcpy(payload + 2, topic, topicLength);
+    frame(type, payload, 2 + topicLength);
+  }
+
+private:
+  static const uint8_t HEADER_SIZE = 10;
+
+  void frame(SerialTraceType type, const uint8_t *payload, uint8_t length) {
+    uint8_t buffer[HEADER_SIZE + MAX_PAYLOAD + 2];
+    uint16_t frameSequence = sequence++;
+    buffer[0] = 0xA5;
+    buffer[1] = 0x5A;
+    buffer[2] = type;
+    buffer[3] = length;
+    buffer[4] = frameSequence & 0xFF;
+    buffer[5] = frameSequence >> 8;
+    put32(buffer + 6, micros());
+    memcpy(buffer + HEADER_SIZE, payload, length);
+    uint16_t crc = crc16(buffer + 2, HEADER_SIZE - 2 + length);
+    buffer[HEADER_SIZE + length] = crc & 0xFF;
+    buffer[HEADER_SIZE + length + 1] = crc >> 8;
+    size_t size = HEADER_SIZE + length + 2;
+    if (static_cast<size_t>(port.availableForWrite()) < size) {
+      framesDropped++;
+      return;
+    }
+    port.write(buffer, size);
+  }
+
+  static uint16_t crc16(const uint8_t *data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    while (length--) {
+      crc ^= static_cast<uint16_t>(*data++) << 8;
+      for (uint8_t bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  static void put32(uint8_t *out, uint32_t value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    out[2] = (value >> 16) & 0xFF;
+    out[3] = value >> 24;
+  }
+
+  static void putFloat(uint8_t *out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put32(out, bits);
+  }
+
+  Stream &port;
+  uint16_t sequence = 0;
+  unsigned long loopStart = 0;
+  uint8_t pins[MAX_PINS];
+  uint8_t levels[MAX_PINS];
+  uint8_t pinCount = 0;
+};
+
+#endif
@@ -37,75 +37,73 @@
 #include <Adafruit_BME680.h>
 #include <IRremoteESP8266.h>
 #include <IRsend.h>
-#include <ir_Samsung.h>
 #include <IRrecv.h>
 #include <IRac.h>
 #include <IRtext.h>
 #include <IRutils.h>
 #endif
 #include "Version.h"
+#include "TargetPolicy.h"
 #include "BootstrapManager.h"
-#include "PingESP.h"
+#if defined(ESP8266)
+#include "GatewayProbe.h"
+#endif
+#include "StatsJournal.h"
+#include "RollingStats.h"
+#include "FixedQueue.h"
+#include "DisplayController.h"
+#include "RemoteClock.h"
+#include "BootProfiler.h"
+#include "DeviceMetrics.h"
+#include "SerialTrace.h"
+#include "CpuGovernor.h"
+#include "PayloadSizeProbe.h"
+#include "RoomRegistry.h"
+#include "MqttPayloads.h"
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+#include "HampelFilter.h"
+#include "DutyCycle.h"
+#include "SensorDriver.h"
+#include "Bme680Driver.h"
+#include "Scd4xDriver.h"
+#include "ClimateUnits.h"
+#endif
 
 
 /****************** BOOTSTRAP and WIFI MANAGER ******************/
 BootstrapManager bootstrapManager;
 Helpers helper;
 #if defined(ESP8266)
-PingESP pingESP;
+GatewayProbe gatewayProbe(1000);
 #endif
 
 /**************************** PIN DEFINITIONS ****************************/
 // #define OLED_RESET LED_BUILTIN // Pin used for integrated D1 Mini blue LED
+// Wiring of the board in use, see TargetPolicy.h
+const uint8_t OLED_BUTTON_PIN = Target::OLED_BUTTON_PIN;
+const uint8_t SMARTOSTAT_BUTTON_PIN = Target::SMARTOSTAT_BUTTON_PIN;
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-#if defined(ESP8266)
-#define OLED_BUTTON_PIN 12 // D6 Pin, 5V power, for capactitive touch sensor. When Sig Output is high, touch sensor is being
-
-#else
-#define OLED_BUTTON_PIN 13 // D6 Pin, 5V power, for capactitive touch sensor. When Sig Output is high, touch sensor is being
-
-#endif
-#else
-#if defined(ESP8266)
-#define OLED_BUTTON_PIN D6 // D5 Pin, 5V power, for capactitive touch sensor. When Sig Output is high, touch sensor is being
-
-#else
-#define OLED_BUTTON_PIN 13 // D5 Pin, 5V power, for capactitive touch sensor. When Sig Output is high, touch sensor is being
-
-#endif
-#endif
-#if defined(ESP8266)
-#define SMARTOSTAT_BUTTON_PIN 15 // D8 pin, 5V power, for touch button used to start stop the furnance
-#else
-#define SMARTOSTAT_BUTTON_PIN 10 // D8 pin, 5V power, for touch button used to start stop the furnance
-#endif
-#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-#if defined(ESP8266)
-#define SR501_PIR_PIN 16 // D0 Pin, 5V power, for SR501 PIR sensor
-#else
-#define SR501_PIR_PIN 4 // D0 Pin, 5V power, for SR501 PIR sensor
-#endif
-#if defined(ESP8266)
-#define RELE_PIN 14 // D5 Pin, 5V power, for relè //TODO configurare releè pin
-#else
-#define RELE_PIN 12 // D5 Pin, 5V power, for relè //TODO configurare releè pin
-#endif
+const uint8_t SR501_PIR_PIN = Target::SR501_PIR_PIN;
+const uint8_t RELE_PIN = Target::RELE_PIN;
 Adafruit_BME680 boschBME680; // D2 pin SDA, D1 pin SCL, 3.3V power for BME680 sensor, sensor address I2C 0x76
-#if defined(ESP8266)
-const uint16_t kIrLed = D3; // GPIOX for IRsender
-#else
-const uint16_t kIrLed = 18; // GPIOX for IRsender
-#endif
-IRSamsungAc acir(kIrLed);
-#if defined(ESP8266)
-const uint16_t KIRLEDRECV = D4; // GPIOX for IRsender
-#else
-const uint16_t KIRLEDRECV = 16; // GPIOX for IRsender
+// the gas heater fires once every SENSOR_GAS_PERIOD ms, the five publish cycles the sensor used to be read on
+#ifndef SENSOR_GAS_PERIOD
+#define SENSOR_GAS_PERIOD 50000
 #endif
+Bme680Driver bme680Driver(boschBME680, 0x76, SENSOR_GAS_PERIOD);
+Scd4xDriver scd4xDriver(Wire); // optional SCD40/SCD41 CO2 sensor on the same bus, address I2C 0x62
+// Sensors probed at boot, when two sensors measure the same channel the first one listed is used
+SensorDriver *const sensorDrivers[] = {&bme680Driver, &scd4xDriver};
+const uint16_t kIrLed = Target::IR_LED_PIN;
+// Climate units, any protocol supported by IRac, configured at runtime
+IRac irac(kIrLed);
+// frames of absolute state protocols are repeated IR_RETRY times, sometimes the off command is not received
+const uint8_t IR_RETRY = 2;
+ClimateUnits climateUnits(irac, 150, IR_RETRY);
+const uint16_t KIRLEDRECV = Target::IR_RECV_PIN;
 // Use turn on the save buffer feature for more complete capture coverage.
 IRrecv irrecv(KIRLEDRECV, 1024, 50, true);
 decode_results results; // Somewhere to store the results
-boolean sensorOk = false;
 #endif
 
 // #define SCREEN_WIDTH 128 // OLED display width, in pixels
@@ -113,13 +111,17 @@ boolean sensorOk = false;
 // // Declaration for an SSD1306 display connected to I2C (SDA, SCL pins) // Address 0x3C for 128x64pixel
 // // D2 pin SDA, D1 pin SCL, 5V power
 // Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+// Contrast, precharge, power and rotation are written to the panel only when they change
+DisplayController displayController(display);
 bool lastState = HIGH;
 bool lastStateSmartostat = HIGH;
 
 /**************************** MQTT TOPICS ****************************/
-const char *SMARTOSTAT_SENSOR_STATE_TOPIC = "tele/smartostat/SENSOR";
+// Topics with a typed payload come from schema/mqtt_payloads.json
+const char *SMARTOSTAT_SENSOR_STATE_TOPIC = SensorState::topic();
 const char *SMARTOSTAT_STATE_TOPIC = "tele/smartostat/STATE";
-const char *SMARTOSTAT_CLIMATE_STATE_TOPIC = "stat/smartostat/CLIMATE";
+const char *SMARTOSTAT_STATS_TOPIC = "tele/smartostat/STATS";
+const char *SMARTOSTAT_CLIMATE_STATE_TOPIC = ClimateState::topic();
 const char *SMARTOSTATAC_CMD_TOPIC = "cmnd/smartostatac/CLIMATE";
 const char *SMARTOSTAT_FURNANCE_STATE_TOPIC = "stat/smartostat/POWER1";
 const char *SMARTOSTAT_PIR_STATE_TOPIC = "stat/smartostat/POWER2";
@@ -139,14 +141,35 @@ const char *CMND_IR_RECEV = "cmnd/irrecev/ACTIVE";
 const char *TOGGLE_BEEP = "cmnd/irrecev/TOGGLE_BEEP";
 const char *LUCIFERIN_FRAMERATE = "lights/firelyluciferin/framerate";
 const char *GLOWORM_FRAMERATE = "lights/glowwormluciferin";
+// Wildcards used only to subscribe, every topic they match is routed by its own name.
+// The solar station publishes more tele topics than the ones shown, those are subscribed one by one.
+const char *SOLAR_STATION_STAT_TOPICS = "stat/solarstation/+";
+const char *IR_RECEV_CMND_TOPICS = "cmnd/irrecev/+";
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
 const char *SMARTOLED_CMND_TOPIC = "cmnd/smartostat/POWER3";
 const char *SMARTOLED_STATE_TOPIC = "stat/smartostat/POWER3";
 const char *SMARTOSTAT_HELLO_TOPIC = "stat/smartostat/hello";
+// no remote rooms
+const uint8_t ROOM_SUBSCRIPTIONS = 0;
 const char *SMARTOLED_INFO_TOPIC = "stat/smartostat/INFO";
 const char *SMARTOSTAT_STAT_REBOOT = "stat/smartostat/reboot";
 const char *SMARTOSTAT_CMND_REBOOT = "cmnd/smartostat/reboot";
 const char *IR_RECV_TOPIC = "tele/irrecv/INFO";
+const char *SMARTOSTAT_LATENCY_TOPIC = "tele/smartostat/LATENCY";
+const char *SMARTOSTAT_DUTY_TOPIC = "tele/smartostat/DUTY";
+const char *BOOT_PROFILE_TOPIC = "tele/smartostat/BOOT";
+const char *METRICS_PREFIX = "smartostat_";
+const char *INGEST_STATE_TOPIC = "tele/smartostat/INGEST";
+// Climate units registry, every unit has its own cmnd/smartostatac/<unit>/IRsend and IRsendCmnd topics
+const char *SMARTOSTATAC_CMND_UNITS = "cmnd/smartostatac/UNITS";
+const char *SMARTOSTATAC_STAT_UNITS = "stat/smartostatac/UNITS";
+const char *SMARTOSTATAC_UNIT_CMND_IRSENDSTATE = "cmnd/smartostatac/+/IRsend";
+const char *SMARTOSTATAC_UNIT_CMND_IRSEND = "cmnd/smartostatac/+/IRsendCmnd";
+const char *CLIMATE_UNITS_FILE = "climate_units.json";
+// The AC of the cmnd/smartostatac topics is the first climate unit, its protocol and model are changed like the others
+const char *PRIMARY_AC_UNIT = "smartostatac";
+const decode_type_t PRIMARY_AC_PROTOCOL = decode_type_t::SAMSUNG_AC;
+const uint8_t PRIMARY_AC = 0;
 #endif
 #if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
 const char *SMARTOLED_CMND_TOPIC = "cmnd/smartoled/POWER3";
@@ -155,6 +178,47 @@ const char *SMARTOLED_INFO_TOPIC = "stat/smartoled/INFO";
 const char *SMARTOLED_STAT_REBOOT = "stat/smartoled/reboot";
 const char *SMARTOLED_CMND_REBOOT = "cmnd/smartoled/reboot";
 const char *SMARTOLED_HELLO_TOPIC = "stat/smartoled/hello";
+const char *BOOT_PROFILE_TOPIC = "tele/smartoled/BOOT";
+const char *METRICS_PREFIX = "smartoled_";
+const char *INGEST_STATE_TOPIC = "tele/smartoled/INGEST";
+// Rooms shown by the smartoled, SMARTOLED_ROOMS is a comma separated list of smartostat topic levels
+// (tele/<room>/SENSOR, stat/<room>/POWER1). The local smartostat is always the first room.
+#ifndef MAX_ROOMS
+#define MAX_ROOMS 4
+#endif
+// one row per room below the title of the rooms page
+static_assert(MAX_ROOMS <= 5, "the rooms page draws up to 5 rooms");
+#ifndef SMARTOLED_ROOMS
+#define SMARTOLED_ROOMS ""
+#endif
+const char *PRIMARY_ROOM = "smartostat";
+// Wildcards used only to route, every room is subscribed by its own topics
+const char *ROOM_SENSOR_TOPICS = "tele/+/SENSOR";
+const char *ROOM_FURNANCE_TOPICS = "stat/+/POWER1";
+// a room is shown as offline when nothing has been received for ROOM_TIMEOUT ms
+const unsigned long ROOM_TIMEOUT = 600000;
+RoomRegistry<MAX_ROOMS> rooms;
+char roomTopics[MAX_ROOMS * 2][Room::NAME_SIZE + 12];
+// the local smartostat topics are subscribed with the others
+const uint8_t ROOM_SUBSCRIPTIONS = (MAX_ROOMS - 1) * 2;
+// Media page, only the smartoled subscribes to SPOTIFY_STATE_TOPIC
+String SPOTIFY_PLAYING = "playing";
+String SPOTIFY_IDLE = "idle";
+String SPOTIFY_PAUSED = "paused";
+String spotifySource = EMPTY_STR;
+String volumeLevel = EMPTY_STR;
+// media position, advanced locally while playing
+RemoteClock mediaClock;
+String mediaArtist = EMPTY_STR;
+String mediaTitle = OFF_CMD;
+String mediaTitlePrevious = OFF_CMD;
+String spotifyPosition = OFF_CMD;
+String spotifyPositionPrevious = OFF_CMD;
+String appName = EMPTY_STR;
+String spotifyActivity = EMPTY_STR;
+String BT_AUDIO = "Bluetooth Audio";
+int offset = 160;
+int offsetAuthor = 130;
 #endif
 
 // HEAT COOL THRESHOLD, USED to MANAGE SITUATIONS WHEN THERE IS NO INFO FROM THE MQTT SERVER (used by smartoled for capacitive button too)
@@ -175,7 +239,9 @@ float humidityThreshold = 80;
 float tempSensorOffset = 0;
 
 // Total Number of pages
-const int numPages = 9;
+const int numPages = 10;
+// Multi room summary, skipped when the smartoled shows a single smartostat
+const int ROOMS_PAGE = 9;
 const float LOW_WATT = 350;
 const float HIGH_WATT = 450;
 float loadFloat;
@@ -201,8 +267,31 @@ float gasResistance = -100.0f;
 float minGasResistance = 2000;
 float maxGasResistance = 0.0;
 float IAQ = -100.0f; // indoor air quality
+float co2 = -100.0f; // ppm, read by the optional SCD4x
 float minIAQ = 2000;
 float maxIAQ = 0.0;
+// Furnance and AC accounting of the current day, accountingDay is the dayKey() of the day they belong to
+float furnanceRuntimeToday = 0;
+float furnanceCyclesToday = 0;
+float heatingDegreeMinutesToday = 0;
+float acRuntimeToday = 0;
+float acCyclesToday = 0;
+float acDegreeMinutesToday = 0;
+float accountingDay = 0;
+// Min/max values persisted on LittleFS, the index is the journal key so add new values at the end only
+float *const persistedStats[] = {
+	&minTemperature, &maxTemperature, &minHumidity, &maxHumidity, &minPressure, &maxPressure,
+	&minGasResistance, &maxGasResistance, &minIAQ, &maxIAQ,
+	&furnanceRuntimeToday, &furnanceCyclesToday, &heatingDegreeMinutesToday, &acRuntimeToday, &acCyclesToday,
+	&accountingDay
+};
+StatsJournal statsJournal("/stats.snp", "/stats.snp.tmp", "/stats.jnl", 256);
+// Streaming statistics fed by every sensor sample, min/max since the last reset are the persisted values above
+SensorStatistics<float> temperatureStats(minTemperature, maxTemperature);
+SensorStatistics<float> humidityStats(minHumidity, maxHumidity);
+SensorStatistics<float> pressureStats(minPressure, maxPressure);
+SensorStatistics<float> gasResistanceStats(minGasResistance, maxGasResistance);
+SensorStatistics<float> IAQStats(minIAQ, maxIAQ);
 float offlineTargetTemp = 20;
 String furnance = OFF_CMD;
 String ac = OFF_CMD;
@@ -220,10 +309,6 @@ String FAN_AUTO = "Auto";
 String FAN_POWER = "Power";
 String FAN_WARM = "Warm";
 
-String SPOTIFY_PLAYING = "playing";
-String SPOTIFY_IDLE = "idle";
-String SPOTIFY_PAUSED = "paused";
-
 String away_mode = OFF_CMD;
 String rebootState = OFF_CMD;
 String alarmo = OFF_CMD;
@@ -238,28 +323,14 @@ bool ssUploadMode = false;
 int ssTriggerCycle = 0;
 int solarStationBattery = 0;
 String solarStationBatteryVoltage = OFF_CMD;
-String solarStationRemainingSeconds = OFF_CMD;
+// water pump countdown, advanced locally between the REMAINING_SECONDS updates
+RemoteClock waterPumpClock;
 String solarStationWifi = OFF_CMD;
 int currentPage = 0;
 bool showHaSplashScreen = true;
 String hours = EMPTY_STR;
 String minutes = EMPTY_STR;
 bool pressed = false;
-String spotifySource = EMPTY_STR;
-String volumeLevel = EMPTY_STR;
-String mediaDuration = EMPTY_STR;
-String mediaPosition = EMPTY_STR;
-String mediaArtist = EMPTY_STR;
-String mediaTitle = OFF_CMD;
-String mediaTitlePrevious = OFF_CMD;
-String spotifyPosition = OFF_CMD;
-String spotifyPositionPrevious = OFF_CMD;
-String appName = EMPTY_STR;
-String spotifyActivity = EMPTY_STR;
-String BT_AUDIO = "Bluetooth Audio";
-uint8_t IR_RETRY = 2;
-int offset = 160;
-int offsetAuthor = 130;
 // variable used for faster delay instead of arduino delay(), this custom delay prevent a lot of problem and memory leak
 const int tenSecondsPeriod = 10000;
 unsigned long timeNowStatus = 0;
@@ -274,7 +345,38 @@ unsigned long lastMillisForWatchdog = millis();
 // PIR variables
 long unsigned int highIn;
 
-unsigned int readOnceEveryNTimess = 0;
+// Sensor sampling, independent from the MQTT publish cadence: four samples per 10 s publish cycle.
+// BME680 is in forced mode, it sleeps between readings to avoid self heating. Only the gas readings fire the heater
+// (SENSOR_GAS_PERIOD), so the heater duty cycle is unchanged.
+#ifndef SENSOR_SAMPLING_PERIOD
+#define SENSOR_SAMPLING_PERIOD 2500
+#endif
+unsigned long lastSensorSample = 0;
+// Samples read since the last publish, published as mean/min/max
+struct SensorInterval {
+	StatsBucket<float> temperature;
+	StatsBucket<float> humidity;
+	StatsBucket<float> pressure;
+	StatsBucket<float> gasResistance;
+	StatsBucket<float> IAQ;
+	StatsBucket<float> co2;
+	StatsBucket<float> scd4xTemperature;
+	StatsBucket<float> scd4xHumidity;
+
+	// Move the new samples into published, a channel without new samples keeps its previous aggregate
+	void moveTo(SensorInterval &published) {
+		StatsBucket<float> *from[] = {&temperature, &humidity, &pressure, &gasResistance, &IAQ, &co2,
+		                              &scd4xTemperature, &scd4xHumidity};
+		StatsBucket<float> *to[] = {&published.temperature, &published.humidity, &published.pressure,
+		                            &published.gasResistance, &published.IAQ, &published.co2,
+		                            &published.scd4xTemperature, &published.scd4xHumidity};
+		for (uint8_t i = 0; i < sizeof(from) / sizeof(from[0]); i++) {
+			if (from[i]->moments.count > 0) *to[i] = *from[i];
+			from[i]->reset();
+		}
+	}
+};
+SensorInterval sensorInterval;
 String lastPirState = OFF_CMD;
 float hum_weighting = 0.25; // so hum effect is 25% of the total air quality score
 float gas_weighting = 0.75; // so gas effect is 75% of the total air quality score
@@ -284,6 +386,9 @@ float hum_reference = 40;
 int getgasreference_count = 0;
 int gas_lower_limit = 10000; // Bad air quality limit
 int gas_upper_limit = 300000; // Good air quality limit
+// Outlier rejection on raw gas readings (heater glitches, I2C errors) and on the computed IAQ
+HampelFilter<float, 9> gasFilter(3, 2000);
+HampelFilter<float, 5> IAQFilter(3, 10);
 #endif
 // only button can force furnance state to ON even when wifi/mqtt is disconnected, the force state is resetted to OFF even by MQTT topic
 bool offlineMode = false;
@@ -314,6 +419,8 @@ struct PublishStep {
 static PublishStep publishStep = { 0 };
 static unsigned long lastPublishTime = 0;
 static bool publishing = false;
+// boot phases, published on BOOT_PROFILE_TOPIC after the first valid publish
+BootProfiler bootProfiler;
 const unsigned long STEP_DELAY = 500;
 
 // 'heat', 33x29px
@@ -635,6 +742,8 @@ void manageDisconnections();
 
 void manageQueueSubscription();
 
+bool subscribeBatch(const char *const *topics, uint8_t count);
+
 void manageHardwareButton();
 
 // Project specific functions
@@ -646,8 +755,6 @@ bool processSmartostatAcJson(JsonDocument json);
 
 bool processSmartostatClimateJson(JsonDocument json);
 
-bool processSpotifyStateJson(JsonDocument json);
-
 bool processSmartostatPirState(JsonDocument json);
 
 bool processSmartoledCmnd(JsonDocument json);
@@ -711,6 +818,15 @@ void writeConfigToStorage();
 
 void resetMinMaxValues();
 
+uint32_t uptimeSeconds();
+
+void addSensorStatistics(float temperatureSample, float humiditySample, float pressureSample,
+                         float gasResistanceSample, float IAQSample);
+
+float dailyMin(SensorStatistics<float> &stats);
+
+float dailyMax(SensorStatistics<float> &stats);
+
 void touchButtonManagement(int pinvalue);
 
 void sendACCommandState();
@@ -719,8 +835,6 @@ void sendClimateState(String mode);
 
 void sendFurnanceCommandState();
 
-void cleanSpotifyInfo();
-
 void goToHomePageAndWriteToStorageAfterFiveMinutes();
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
 void sendSmartostatRebootState(String onOff);
@@ -731,6 +845,17 @@ void sendPirState();
 
 void sendSensorState();
 
+void sampleSensors();
+
+void applySensorReading(const SensorDriver &driver, const SensorReading &reading);
+
+void addSensorInterval(float &mean, float &min, float &max, const StatsBucket<float> &interval);
+
+void sendStatisticsState();
+
+template<uint8_t BUCKETS>
+void addWindowStatistics(JsonObject root, const char *name, const RollingWindow<float, BUCKETS> &window, uint32_t now);
+
 void pirManagement();
 
 void releManagement();
@@ -745,13 +870,32 @@ bool processIrOnOffCmnd(JsonDocument json);
 
 bool processIrSendCmnd(JsonDocument json);
 
+bool processClimateUnitsCmnd(JsonDocument json);
+
+bool processUnitOnOffCmnd(JsonDocument json);
+
+bool processUnitSendCmnd(JsonDocument json);
+
+int8_t findTopicUnit();
+
+bool applyClimateCommand(stdAc::state_t &state, JsonDocument &json);
+
+void readClimateUnits();
+
+void writeClimateUnits();
+
+void sendClimateUnitsState();
+
+void sendUnitACState(uint8_t index);
+
+void manageClimateUnits();
+
 bool processSmartostatRebootCmnd(JsonDocument json);
 
 bool toggleBeep(JsonDocument json);
 
 void getGasReference();
 
-void getGasReferenceBlocking();
 
 float calculateIAQ(float score);
 
@@ -766,8 +910,243 @@ void sendSmartoledRebootState(String onOff);
 void sendSmartoledRebootCmnd();
 bool processSmartostatFurnanceState(JsonDocument json);
 bool processACState(JsonDocument json);
+bool processRoomSensorJson(JsonDocument json);
+bool processRoomFurnanceState(JsonDocument json);
+void updateRoomSensor(float roomTemperature, float roomHumidity);
+void setupRooms();
+uint8_t addRoomSubscriptions(const char **topics);
+void drawRoomsPage();
 bool processSmartoledRebootCmnd(JsonDocument json);
+bool processSpotifyStateJson(JsonDocument json);
+void cleanSpotifyInfo();
 #endif
 bool isButtonHeldAtBoot();
+uint8_t roomsCount();
+bool mediaPlaying();
+void drawMediaPage();
+void runBootTasks();
+void loadStoredConfig();
+void sendBootProfile();
 void handleUpButton();
-void handleDownButton();
\ No newline at end of file
+void handleDownButton();
+
+/**************************** INBOUND MESSAGES ****************************/
+// MQTT messages are queued by callback() and executed from the main loop within INBOUND_BUDGET_MS,
+// commands driving an actuator are executed before the display only updates.
+// High rate display only topics use a single slot mailbox instead: only the latest payload is kept
+// and it's parsed by the loop within the same budget, values shown by a single page wait until it's on screen.
+enum InboundPriority : uint8_t {
+	PRIORITY_ACTUATOR,
+	PRIORITY_DISPLAY,
+	PRIORITY_LATEST
+};
+
+// Byte identical payloads are dropped before parsing unless the route must always be executed
+struct InboundRoute {
+	const char *topic;
+	bool (*handler)(JsonDocument json);
+	InboundPriority priority;
+	bool alwaysProcess;
+};
+
+struct InboundCommand {
+	uint8_t route = 0;
+	unsigned long receivedAt = 0;
+	// raw payload, parsed within the loop budget
+	String payload;
+	// only for routes with a '+' wildcard
+	String topic;
+};
+
+const InboundRoute inboundRoutes[] = {
+	{SMARTOSTAT_SENSOR_STATE_TOPIC, processSmartostatSensorJson, PRIORITY_DISPLAY},
+	{SMARTOSTAT_STATE_TOPIC, processSmartostatSensorJson, PRIORITY_DISPLAY},
+	{SMARTOSTAT_CLIMATE_STATE_TOPIC, processSmartostatClimateJson, PRIORITY_DISPLAY},
+	{UPS_STATE, processUpsStateJson, PRIORITY_LATEST},
+	{SMARTOSTAT_PIR_STATE_TOPIC, processSmartostatPirState, PRIORITY_DISPLAY},
+	{SMARTOLED_CMND_TOPIC, processSmartoledCmnd, PRIORITY_ACTUATOR, true},
+	{SMARTOSTAT_FURNANCE_CMND_TOPIC, processFurnancedCmnd, PRIORITY_ACTUATOR, true},
+	{SOLAR_STATION_POWER_STATE, processSolarStationPowerState, PRIORITY_DISPLAY, true},
+	{SOLAR_STATION_PUMP_POWER, processSolarStationWaterPump, PRIORITY_DISPLAY, true},
+	{SOLAR_STATION_STATE, processSolarStationState, PRIORITY_LATEST},
+	// a new pump run often starts with the payload the previous one started with, never a duplicate
+	{SOLAR_STATION_REMAINING_SECONDS, processSolarStationRemainingSeconds, PRIORITY_LATEST, true},
+	{CMND_IR_RECEV, processIrRecev, PRIORITY_ACTUATOR, true},
+	{GLOWORM_FRAMERATE, processSmartoledGlowWormFramerate, PRIORITY_LATEST},
+	{LUCIFERIN_FRAMERATE, processSmartoledFramerate, PRIORITY_LATEST},
+#if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
+	{SMARTOSTATAC_CMD_TOPIC, processSmartostatAcJson, PRIORITY_DISPLAY, true},
+	{SMARTOSTAT_FURNANCE_STATE_TOPIC, processSmartostatFurnanceState, PRIORITY_DISPLAY},
+	{SMARTOSTATAC_STAT_IRSEND, processACState, PRIORITY_DISPLAY},
+	{SMARTOLED_CMND_REBOOT, processSmartoledRebootCmnd, PRIORITY_ACTUATOR, true},
+	{SPOTIFY_STATE_TOPIC, processSpotifyStateJson, PRIORITY_LATEST, true},
+	// after the local smartostat topics, the first matching route wins
+	// the rooms share the route and its fingerprint, the same payload from another room is not a duplicate
+	{ROOM_SENSOR_TOPICS, processRoomSensorJson, PRIORITY_DISPLAY, true},
+	{ROOM_FURNANCE_TOPICS, processRoomFurnanceState, PRIORITY_DISPLAY, true},
+#endif
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+	{SMARTOSTATAC_CMND_IRSENDSTATE, processIrOnOffCmnd, PRIORITY_ACTUATOR, true},
+	{SMARTOSTATAC_CMND_IRSEND, processIrSendCmnd, PRIORITY_ACTUATOR, true},
+	{SMARTOSTAT_CMND_REBOOT, processSmartostatRebootCmnd, PRIORITY_ACTUATOR, true},
+	{TOGGLE_BEEP, toggleBeep, PRIORITY_ACTUATOR, true},
+	{SMARTOSTATAC_CMND_UNITS, processClimateUnitsCmnd, PRIORITY_ACTUATOR, true},
+	{SMARTOSTATAC_UNIT_CMND_IRSENDSTATE, processUnitOnOffCmnd, PRIORITY_ACTUATOR, true},
+	{SMARTOSTATAC_UNIT_CMND_IRSEND, processUnitSendCmnd, PRIORITY_ACTUATOR, true},
+#endif
+};
+const uint8_t inboundRoutesCount = sizeof(inboundRoutes) / sizeof(inboundRoutes[0]);
+
+// Runtime state of every route
+struct InboundTopicState {
+	bool fingerprinted = false;
+	uint32_t fingerprint = 0;
+	bool latestPending = false;
+	unsigned long latestReceivedAt = 0;
+	String latest;
+};
+InboundTopicState inboundTopics[inboundRoutesCount];
+
+// Ingest statistics of every route, published on INGEST_STATE_TOPIC
+struct InboundTopicStats {
+	uint32_t messages = 0;
+	uint32_t bytes = 0;
+	uint32_t parseMicros = 0;
+	uint32_t handlerMicros = 0;
+	uint32_t parseFailures = 0;
+	unsigned long lastSeen = 0;
+};
+InboundTopicStats inboundStats[inboundRoutesCount];
+uint32_t inboundUnrouted = 0;
+// PUBLISH packets larger than MQTT_MAX_PACKET_SIZE, dropped
+PayloadSizeProbe payloadSizeProbe;
+uint32_t inboundOversized = 0;
+uint32_t inboundOversizedBytes = 0;
+char inboundOversizedTopic[48] = "";
+uint32_t inboundSuperseded = 0;
+uint32_t inboundDuplicates = 0;
+FixedQueue<InboundCommand, 8> actuatorQueue;
+FixedQueue<InboundCommand, 12> displayQueue;
+const unsigned long INBOUND_BUDGET_MS = 15;
+// payload bytes held by both queues, a retained burst after a reconnect can't exhaust the heap
+#ifndef INBOUND_QUEUE_BYTES
+#define INBOUND_QUEUE_BYTES 3072
+#endif
+uint16_t inboundQueuedBytes = 0;
+uint32_t inboundDropped = 0;
+uint32_t inboundRejected = 0;
+// next mailbox parsed by processInboundMailboxes()
+uint8_t inboundMailboxCursor = 0;
+
+// Topic of the message being executed and when callback() received it, valid during the handler call
+const char *inboundTopic = nullptr;
+unsigned long inboundReceivedAt = 0;
+
+int findInboundRoute(const char *topic);
+
+bool topicMatches(const char *filter, const char *topic);
+
+uint32_t payloadFingerprint(const byte *payload, unsigned int length);
+
+void processInboundQueue();
+
+void executeInbound(InboundCommand &command);
+
+bool isInboundRendered(uint8_t route);
+
+void processInboundMailboxes(unsigned long budgetStart);
+
+bool isParseFailure(const byte *payload, unsigned int length, JsonDocument &json);
+
+void sendIngestState();
+
+// Actuator command tracing: receipt (callback), actuation and acknowledgement timestamps in device millis().
+// Commands can carry an optional correlation id as {"VALUE": "ON", "cid": "..."}.
+const char *CORRELATION_ID = "cid";
+struct CommandTrace {
+	unsigned long receivedAt = 0;
+	unsigned long actuatedAt = 0;
+	String correlationId;
+};
+CommandTrace commandTrace;
+
+void markActuated();
+
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+void sendCommandLatency(const char *command);
+
+// IRsendCmnd bursts (temperature slider, fan mode cycling) are merged into the desired state of the primary AC
+// and transmitted once, AC_COALESCING_WINDOW ms after the last command. A state equal to the last transmitted one is not sent.
+#ifndef AC_COALESCING_WINDOW
+#define AC_COALESCING_WINDOW 400
+#endif
+CommandTrace acFrameTrace;
+
+void sendAcPower(bool on);
+
+// Runtime and cycles of the furnance relay and of the AC, heating degree-minutes while the thermostat heats
+DutyCycle furnanceDuty(furnanceRuntimeToday, furnanceCyclesToday, heatingDegreeMinutesToday);
+// the AC doesn't integrate degree-minutes, acDegreeMinutesToday is not persisted
+DutyCycle acDuty(acRuntimeToday, acCyclesToday, acDegreeMinutesToday);
+// target of the thermostat while heating, NAN otherwise
+float heatingTarget = NAN;
+
+float dayKey(const String &isoTime);
+
+void checkAccountingDay();
+
+void addDutyCycle(JsonObject root, const char *name, const DutyCycle &duty, bool degreeMinutes);
+
+void sendDutyCycleState();
+#endif
+
+/**************************** METRICS ****************************/
+// Optional HTTP server answering GET /metrics in the Prometheus text format, scraped independently of the broker
+#ifndef METRICS_ENABLED
+#define METRICS_ENABLED false
+#endif
+#ifndef METRICS_PORT
+#define METRICS_PORT 9100
+#endif
+DeviceMetrics deviceMetrics;
+
+// BootstrapManager::publish() that counts the outgoing messages
+void publishMqtt(const char *topic, const char *payload, boolean retained);
+
+void publishMqtt(const char *topic, JsonObject payload, boolean retained);
+
+#if METRICS_ENABLED
+#if defined(ESP8266)
+#include <ESP8266WebServer.h>
+ESP8266WebServer metricsServer(METRICS_PORT);
+#else
+#include <WebServer.h>
+WebServer metricsServer(METRICS_PORT);
+#endif
+
+void handleMetrics();
+
+void sendMetricsChunk(const char *text, size_t length);
+#endif
+
+/**************************** SERIAL TRACE ****************************/
+// Profiling mode, binary frames with loop timings, raw sensor values, button/PIR edges and MQTT events are streamed
+// over the serial port at SERIAL_TRACE_RATE. Decode them with tools/serial_trace.py
+#ifndef SERIAL_TRACE_ENABLED
+#define SERIAL_TRACE_ENABLED false
+#endif
+#ifndef SERIAL_TRACE_RATE
+#define SERIAL_TRACE_RATE 921600
+#endif
+SerialTrace serialTrace(Serial);
+
+/**************************** CPU FREQUENCY ****************************/
+// Idle frequency while nothing is rendered or parsed for CPU_IDLE_DELAY ms, timing frequency during IR capture
+// and transmission, boost frequency (board_build.f_cpu) otherwise. Residency is in the INFO state and /metrics.
+#ifndef CPU_SCALING_ENABLED
+#define CPU_SCALING_ENABLED true
+#endif
+#ifndef CPU_IDLE_DELAY
+#define CPU_IDLE_DELAY 1000
+#endif
+CpuGovernor cpuGovernor(CPU_SCALING_ENABLED, CPU_IDLE_DELAY);
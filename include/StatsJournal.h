@@ -0,0 +1,227 @@
+/*
+  StatsJournal.h - Wear aware persistence for the Smartostat min/max statistics
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_STATS_JOURNAL_H
+#define _DPSOFTWARE_STATS_JOURNAL_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+// Append only journal of float values.
+// Only the values changed since the last flush are appended, one small CRC protected record each.
+// When the journal grows past compactThreshold records the whole set is written to a snapshot
+// and the journal restarts. A torn record (power loss while writing) is detected by its CRC and dropped.
+class StatsJournal {
+
+public:
+  static const uint8_t MAX_VALUES = 16;
+
+  StatsJournal(const char *snapshotPath, const char *snapshotTmpPath, const char *journalPath,
+               uint16_t compactThreshold)
+    : snapshotPath(snapshotPath), snapshotTmpPath(snapshotTmpPath), journalPath(journalPath),
+      compactThreshold(compactThreshold) {
+  }
+
+  // Values are identified by their index, append new values at the end only
+  void attach(float *const *trackedValues, uint8_t count) {
+    values = trackedValues;
+    valuesCount = (count > MAX_VALUES) ? MAX_VALUES : count;
+    markPersisted();
+  }
+
+  // Load the snapshot and replay the journal on top of it, false if nothing has been stored yet
+  bool restore() {
+    if (!LittleFS.begin()) {
+      return false;
+    }
+    bool restored = false;
+    bool torn = false;
+    if (LittleFS.exists(snapshotPath)) {
+      restored = replay(snapshotPath, torn);
+    } else if (LittleFS.exists(snapshotTmpPath)) {
+      // power loss between snapshot removal and rename
+      restored = replay(snapshotTmpPath, torn);
+    }
+    journalRecords = 0;
+    if (LittleFS.exists(journalPath)) {
+      restored |= replay(journalPath, torn);
+    }
+    markPersisted();
+    // records after a torn one can't be trusted and nothing may be appended after the torn bytes,
+    // start from a clean snapshot
+    if (torn || (restored && !LittleFS.exists(snapshotPath))) {
+      if (!compact() && torn) {
+        // the next flush journals every value again
+        LittleFS.remove(journalPath);
+        journalRecords = 0;
+        rewriteAll = true;
+      }
+    }
+    return restored;
+  }
+
+  // Append the changed values, compact when the journal is too long. Returns the number of records written.
+  uint8_t flush() {
+    uint8_t written = 0;
+    File journal;
+    for (uint8_t key = 0; key < valuesCount; key++) {
+      if (!rewriteAll && memcmp(values[key], &persisted[key], sizeof(float)) == 0) {
+        continue;
+      }
+      if (!journal) {
+        journal = LittleFS.open(journalPath, "a");
+        if (!journal) {
+          return written;
+        }
+      }
+      Record record = makeRecord(key, *values[key]);
+      if (journal.write(reinterpret_cast<const uint8_t *>(&record), sizeof(Record)) != sizeof(Record)) {
+        break;
+      }
+      persisted[key] = *values[key];
+      written++;
+    }
+    if (journal) {
+      journal.close();
+    }
+    if (written == valuesCount) {
+      rewriteAll = false;
+    }
+    journalRecords += written;
+    recordsWritten += written;
+    if (journalRecords >= compactThreshold) {
+      compact();
+    }
+    return written;
+  }
+
+  // Rewrite every value into a fresh snapshot and truncate the journal.
+  // False if the snapshot couldn't be written completely, the previous snapshot and journal are kept.
+  bool compact() {
+    File snapshot = LittleFS.open(snapshotTmpPath, "w");
+    if (!snapshot) {
+      return false;
+    }
+    bool complete = true;
+    for (uint8_t key = 0; key < valuesCount && complete; key++) {
+      Record record = makeRecord(key, *values[key]);
+      complete = snapshot.write(reinterpret_cast<const uint8_t *>(&record), sizeof(Record)) == sizeof(Record);
+    }
+    snapshot.close();
+    if (!complete) {
+      return false;
+    }
+    LittleFS.remove(snapshotPath);
+    LittleFS.rename(snapshotTmpPath, snapshotPath);
+    LittleFS.remove(journalPath);
+    markPersisted();
+    journalRecords = 0;
+    rewriteAll = false;
+    compactions++;
+    return true;
+  }
+
+  uint32_t recordsWritten = 0;
+  uint32_t compactions = 0;
+  uint32_t corruptRecords = 0;
+
+private:
+  static const uint8_t RECORD_MAGIC = 0xA5;
+
+  struct Record {
+    uint8_t magic;
+    uint8_t key;
+    uint16_t crc;
+    float value;
+  };
+
+  static uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF) {
+    // CRC-16/CCITT-FALSE
+    while (len--) {
+      crc ^= static_cast<uint16_t>(*data++) << 8;
+      for (uint8_t i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  static uint16_t recordCrc(const Record &record) {
+    uint16_t crc = crc16(&record.magic, 1);
+    crc = crc16(&record.key, 1, crc);
+    return crc16(reinterpret_cast<const uint8_t *>(&record.value), sizeof(float), crc);
+  }
+
+  static Record makeRecord(uint8_t key, float value) {
+    Record record = {RECORD_MAGIC, key, 0, value};
+    record.crc = recordCrc(record);
+    return record;
+  }
+
+  bool replay(const char *path, bool &torn) {
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+      return false;
+    }
+    bool applied = false;
+    Record record;
+    for (;;) {
+      size_t bytesRead = file.read(reinterpret_cast<uint8_t *>(&record), sizeof(Record));
+      if (bytesRead != sizeof(Record)) {
+        // a partial record is the tail of an interrupted append
+        if (bytesRead > 0) {
+          corruptRecords++;
+          torn = true;
+        }
+        break;
+      }
+      if (record.magic != RECORD_MAGIC || record.crc != recordCrc(record)) {
+        corruptRecords++;
+        torn = true;
+        break;
+      }
+      if (record.key < valuesCount) {
+        *values[record.key] = record.value;
+        applied = true;
+      }
+      journalRecords++;
+    }
+    file.close();
+    return applied;
+  }
+
+  void markPersisted() {
+    for (uint8_t key = 0; key < valuesCount; key++) {
+      persisted[key] = *values[key];
+    }
+  }
+
+  const char *snapshotPath;
+  const char *snapshotTmpPath;
+  const char *journalPath;
+  uint16_t compactThreshold;
+  float *const *values = nullptr;
+  uint8_t valuesCount = 0;
+  uint16_t journalRecords = 0;
+  // set when the journal has been dropped without a snapshot
+  bool rewriteAll = false;
+  float persisted[MAX_VALUES] = {};
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*
+  TargetPolicy.h - Role and board policies of the Smartostat and Smartoled firmwares
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_TARGET_POLICY_H
+#define _DPSOFTWARE_TARGET_POLICY_H
+
+#include <Arduino.h>
+
+// What the device does
+struct SmartostatRole {
+  // BME680, relay, IR transmitter/receiver, PIR and the furnance button
+  static constexpr bool HAS_CLIMATE_CONTROL = true;
+  // the display stays off unless the screen is on
+  static constexpr bool WAKES_ON_HIGH_LOAD = false;
+  static constexpr uint8_t DISPLAY_ADDRESS = 0x3C;
+};
+
+struct SmartoledRole {
+  static constexpr bool HAS_CLIMATE_CONTROL = false;
+  // the UPS page is shown when the load is over HIGH_WATT, even with the screen off
+  static constexpr bool WAKES_ON_HIGH_LOAD = true;
+  static constexpr uint8_t DISPLAY_ADDRESS = 0x3D;
+};
+
+// How the device is wired, GPIO numbers
+struct D1MiniBoard {
+  static constexpr uint8_t OLED_BUTTON_PIN = 12;       // D6, capacitive touch sensor, HIGH when touched
+  static constexpr uint8_t SMARTOSTAT_BUTTON_PIN = 15; // D8, touch button used to start stop the furnance
+  static constexpr uint8_t SR501_PIR_PIN = 16;         // D0, SR501 PIR sensor
+  static constexpr uint8_t RELE_PIN = 14;              // D5, relè
+  static constexpr uint16_t IR_LED_PIN = 0;            // D3, IR sender
+  static constexpr uint16_t IR_RECV_PIN = 2;           // D4, IR receiver
+};
+
+struct Esp32S3Board {
+  static constexpr uint8_t OLED_BUTTON_PIN = 13;
+  static constexpr uint8_t SMARTOSTAT_BUTTON_PIN = 10;
+  static constexpr uint8_t SR501_PIR_PIN = 4;
+  static constexpr uint8_t RELE_PIN = 12;
+  static constexpr uint16_t IR_LED_PIN = 18;
+  static constexpr uint16_t IR_RECV_PIN = 16;
+};
+
+template<typename Role, typename Board>
+struct TargetPolicy : Role, Board {
+};
+
+// The only place where the build flags select the role and the board.
+// Role decisions in shared code (pins, display address, wake on load) go through Target.
+// Target doesn't replace the TARGET_ macros: state, headers and code of one role only (sensor drivers, BME680,
+// IRremoteESP8266, climate units, rooms, media page) stay behind them, so the other role doesn't compile them in.
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+typedef SmartostatRole TargetRole;
+#else
+typedef SmartoledRole TargetRole;
+#endif
+#if defined(ESP8266)
+typedef D1MiniBoard TargetBoard;
+#else
+typedef Esp32S3Board TargetBoard;
+#endif
+typedef TargetPolicy<TargetRole, TargetBoard> Target;
+
+#endif
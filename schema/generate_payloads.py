@@ -0,0 +1,239 @@
+"""
+  generate_payloads.py - Generate include/MqttPayloads.h from schema/mqtt_payloads.json
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+
+  Every payload becomes a struct with fixed size fields, an encoder that writes the JSON text into a caller buffer
+  and a decoder that walks the JSON object once. Run it standalone or as a PlatformIO pre script.
+"""
+
+import json
+import os
+import re
+import sys
+
+SCALARS = {
+    "float": "float",
+    "int32": "int32_t",
+    "uint32": "uint32_t",
+    "bool": "bool",
+}
+
+
+def member_name(field):
+    if "name" in field:
+        return field["name"]
+    key = field["key"]
+    if re.fullmatch(r"[A-Z0-9]+", key):
+        return key.lower()
+    parts = key.split("_")
+    name = parts[0][0].lower() + parts[0][1:]
+    return name + "".join(part[:1].upper() + part[1:] for part in parts[1:])
+
+
+class Generator:
+
+    def __init__(self, schema):
+        self.schema = schema
+        self.structs = []
+        self.emitted = set()
+
+    def struct_of(self, field, owner):
+        """Struct name of an object field, None for scalars and strings"""
+        kind = field["type"]
+        if kind == "object":
+            return field.get("struct", owner + field["key"][:1].upper() + field["key"][1:])
+        if kind in self.schema.get("types", {}):
+            return kind
+        return None
+
+    def collect(self, name, fields):
+        """Structs in dependency order, nested ones first"""
+        if name in self.emitted:
+            return
+        for field in fields:
+            nested = self.struct_of(field, name)
+            if nested is None:
+                continue
+            nested_fields = field["fields"] if field["type"] == "object" else self.schema["types"][field["type"]]
+            self.collect(nested, nested_fields)
+        self.emitted.add(name)
+        self.structs.append((name, fields))
+
+    def struct(self, name, fields, topic):
+        lines = ["struct %s {" % name]
+        if topic is not None:
+            lines.append("  static const char *topic() {")
+            lines.append("    return \"%s\";" % topic)
+            lines.append("  }")
+            lines.append("")
+        for field in fields:
+            member = member_name(field)
+            nested = self.struct_of(field, name)
+            if nested is not None:
+                lines.append("  %s %s;" % (nested, member))
+            elif field["type"] == "string":
+                lines.append("  char %s[%d] = \"\";" % (member, field["size"]))
+            elif field["type"] in SCALARS:
+                default = "false" if field["type"] == "bool" else "0"
+                lines.append("  %s %s = %s;" % (SCALARS[field["type"]], member, default))
+            else:
+                sys.exit("Unknown type %s of %s.%s" % (field["type"], name, field["key"]))
+        lines.append("  // true once decoded from a message, optional objects are encoded only when true")
+        lines.append("  bool present = false;")
+        lines.append("};")
+        return lines
+
+    def encoder(self, name, fields):
+        lines = ["inline void encodeJson(PayloadWriter &writer, const %s &value) {" % name,
+                 "  writer.beginObject();"]
+        for field in fields:
+            member = member_name(field)
+            if field.get("optional"):
+                # optional objects are written only when present is set
+                lines.append("  if (value.%s.present) {" % member)
+                lines.append("    writer.key(\"%s\");" % field["key"])
+                lines.append("    encodeJson(writer, value.%s);" % member)
+                lines.append("  }")
+                continue
+            lines.append("  writer.key(\"%s\");" % field["key"])
+            if self.struct_of(field, name) is not None:
+                lines.append("  encodeJson(writer, value.%s);" % member)
+            elif field["type"] == "string":
+                lines.append("  writer.string(value.%s);" % member)
+            elif field["type"] == "float":
+                lines.append("  writer.number(value.%s, %d);" % (member, field.get("decimals", 2)))
+            elif field["type"] == "bool":
+                lines.append("  writer.boolean(value.%s);" % member)
+            else:
+                lines.append("  writer.number(value.%s);" % member)
+        lines.append("  writer.endObject();")
+        lines.append("}")
+        return lines
+
+    def decoder(self, name, fields):
+        # members are dispatched on the key length first, then compared
+        by_length = {}
+        for field in fields:
+            by_length.setdefault(len(field["key"]), []).append(field)
+        lines = ["inline uint8_t decodeJson(JsonObjectConst object, %s &value) {" % name,
+                 "  uint8_t decoded = 0;",
+                 "  for (JsonPairConst member : object) {",
+                 "    const char *key = member.key().c_str();",
+                 "    switch (member.key().size()) {"]
+        for length in sorted(by_length):
+            lines.append("      case %d:" % length)
+            for index, field in enumerate(by_length[length]):
+                member = member_name(field)
+                condition = "if (strcmp(key, \"%s\") == 0) {" % field["key"]
+                if index == 0:
+                    lines.append("        " + condition)
+                else:
+                    lines[-1] = "        } else " + condition
+                if self.struct_of(field, name) is not None:
+                    lines.append("          decoded += decodeJson(member.value().as<JsonObjectConst>(), value.%s);" % member)
+                elif field["type"] == "string":
+                    lines.append("          decodeString(member.value(), value.%s, sizeof(value.%s));" % (member, member))
+                    lines.append("          decoded++;")
+                else:
+                    lines.append("          value.%s = member.value().as<%s>();" % (member, SCALARS[field["type"]]))
+                    lines.append("          decoded++;")
+                lines.append("        }")
+            lines.append("        break;")
+        lines.append("    }")
+        lines.append("  }")
+        lines.append("  value.present = !object.isNull();")
+        lines.append("  return decoded;")
+        lines.append("}")
+        return lines
+
+    def generate(self):
+        payloads = self.schema["payloads"]
+        for name, payload in payloads.items():
+            self.collect(name, payload["fields"])
+        out = [HEADER]
+        for name, fields in self.structs:
+            topic = payloads[name]["topic"] if name in payloads else None
+            out += self.struct(name, fields, topic)
+            out.append("")
+            out += self.encoder(name, fields)
+            out.append("")
+            out += self.decoder(name, fields)
+            out.append("")
+        for name in payloads:
+            out.append("// Encode the %s payload into buffer, returns its length or 0 if it does not fit" % name)
+            out.append("inline size_t encodeJson(const %s &value, char *buffer, size_t size) {" % name)
+            out.append("  PayloadWriter writer(buffer, size);")
+            out.append("  encodeJson(writer, value);")
+            out.append("  return writer.finish();")
+            out.append("}")
+            out.append("")
+        out.append("#endif")
+        return "\n".join(out) + "\n"
+
+
+HEADER = """/*
+  MqttPayloads.h - Typed MQTT payloads shared by the Smartostat and the Smartoled
+
+  GENERATED by schema/generate_payloads.py from schema/mqtt_payloads.json, DO NOT EDIT.
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+*/
+
+#ifndef _DPSOFTWARE_MQTT_PAYLOADS_H
+#define _DPSOFTWARE_MQTT_PAYLOADS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "PayloadCodec.h"
+"""
+
+
+def main(project_dir):
+    schema_path = os.path.join(project_dir, "schema", "mqtt_payloads.json")
+    header_path = os.path.join(project_dir, "include", "MqttPayloads.h")
+    with open(schema_path, encoding="utf-8") as schema_file:
+        header = Generator(json.load(schema_file)).generate()
+    current = None
+    if os.path.exists(header_path):
+        with open(header_path, encoding="utf-8") as header_file:
+            current = header_file.read()
+    # don't touch an up to date header, it would rebuild every translation unit
+    if header != current:
+        with open(header_path, "w", encoding="utf-8", newline="\n") as header_file:
+            header_file.write(header)
+        print("Generated " + header_path)
+
+
+try:
+    Import("env")  # noqa: F821, PlatformIO pre script
+    main(env.subst("$PROJECT_DIR"))  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        main(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
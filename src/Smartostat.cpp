@@ -41,9 +41,8 @@ void setup() {
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
   // IRSender Begin
   pinMode(kIrLed, OUTPUT);
-  acir.begin();
-  acir.calibrate();
-  Serial.begin(SERIAL_RATE);
+  bootProfiler.mark("ir");
+  Serial.begin(SERIAL_TRACE_ENABLED ? SERIAL_TRACE_RATE : SERIAL_RATE);
   Serial.setTimeout(0);
 #if defined(ARDUINO_ARCH_ESP32)
   Serial.setTxTimeoutMs(0);
@@ -59,44 +58,42 @@ void setup() {
   // Relè PIN
   pinMode(RELE_PIN, OUTPUT);
 
-  // BME680 initialization
-  if (!boschBME680.begin(0x76)) {
-    Serial.println("Could not find a valid BME680 sensor, check wiring!");
+  // Sensors initialization, each channel is taken from the first sensor that measures it
+  uint8_t takenChannels = 0;
+  for (SensorDriver *driver : sensorDrivers) {
+    driver->present = driver->begin();
+    if (!driver->present) {
+      Serial.print(F("Could not find a valid "));
+      Serial.print(driver->name());
+      Serial.println(F(" sensor, check wiring!"));
 #if defined(ESP8266)
-    ESP.wdtFeed();
+      ESP.wdtFeed();
 #endif
-    delay(50);
-    sensorOk = false;
-  } else {
-    sensorOk = true;
-    boschBME680.setTemperatureOversampling(BME680_OS_8X); // BME680_OS_1X/BME680_OS_8X
-    boschBME680.setHumidityOversampling(BME680_OS_2X); // BME680_OS_1X/BME680_OS_2X
-    boschBME680.setPressureOversampling(BME680_OS_4X); // BME680_OS_1X/BME680_OS_4X
-    boschBME680.setIIRFilterSize(BME680_FILTER_SIZE_0); // BME680_FILTER_SIZE_0/BME680_FILTER_SIZE_3
-    boschBME680.setGasHeater(320, 150); // 320*C for 150 ms
+      continue;
+    }
+    driver->owned = driver->channels() & ~takenChannels;
+    takenChannels |= driver->owned;
+  }
+  if (bme680Driver.present) {
     // Now run the sensor to normalise the readings, then use combination of relative humidity and gas resistance to estimate indoor air quality as a percentage.
-    // The sensor takes ~30-mins to fully stabilise
-    getGasReferenceBlocking();
-    delay(30);
+    // The sensor takes ~30-mins to fully stabilise.
+    // The gas reference is read by the loop with the non blocking getGasReference(), setup() doesn't wait for the burn-in.
+    // Only the offline mode prompt runs it early (runBootTasks), a normal boot starts it after bootstrapSetup().
+    readGas = true;
   }
+  bootProfiler.mark("sensor");
 
-  acir.stateReset();
-  acir.off();
-  acir.setFan(kSamsungAcFanLow);
-  acir.setMode(kSamsungAcCool);
-  acir.setTemp(26);
-  acir.setSwing(false);
-  //Serial.printf("  %s\n", acir.toString().c_str());
 
   // Display Rotation 180°
-  display.setRotation(2);
+  displayController.setRotation(2);
 
 #else
-  Serial.begin(SERIAL_RATE);
+  Serial.begin(SERIAL_TRACE_ENABLED ? SERIAL_TRACE_RATE : SERIAL_RATE);
   Serial.setTimeout(0);
 #if defined(ARDUINO_ARCH_ESP32)
   Serial.setTxTimeoutMs(0);
 #endif
+  setupRooms();
 #endif
 
   // Wait for the serial connection to be establised.
@@ -108,6 +105,8 @@ void setup() {
   delay(50);
   }
 #endif
+  serialTrace.enabled = SERIAL_TRACE_ENABLED;
+  bootProfiler.mark("serial");
 
   // OLED TouchButton
   pinMode(OLED_BUTTON_PIN, INPUT);
@@ -116,12 +115,7 @@ void setup() {
   pinMode(LED_BUILTIN, OUTPUT);
 
   // SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
-#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-  if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
-    // Address 0x3D for 128x64
-#else
-    if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3D)) {  // Address 0x3D for 128x64
-#endif
+  if (!display.begin(SSD1306_SWITCHCAPVCC, Target::DISPLAY_ADDRESS)) {
     Serial.println(F("SSD1306 allocation failed"));
 #if defined(ESP8266)
     ESP.wdtFeed();
@@ -130,7 +124,10 @@ void setup() {
     for (;;); // Don't proceed, loop forever
   }
 
+  // begin() resets the panel registers
+  displayController.invalidate();
   display.setTextColor(WHITE);
+  bootProfiler.mark("display");
 #if defined(ARDUINO_ARCH_ESP32)
   rgbLedWrite(LED_BUILTIN, 0, 0, 255);
 #endif
@@ -138,10 +135,29 @@ void setup() {
   blockingMqtt = false;
 
   offlineMode = !isButtonHeldAtBoot();
+  bootProfiler.mark("offlinePrompt");
 
   if (!offlineMode) {
+    loadStoredConfig();
     bootstrapManager.bootstrapSetup(manageDisconnections, manageHardwareButton, callback);
-    readConfigFromStorage();
+    displayController.forgetFrame();
+    bootProfiler.mark("network");
+    // oversized payloads reach callback() truncated instead of being dropped silently
+    mqttClient.setStream(payloadSizeProbe);
+#if defined(ESP8266)
+    gatewayProbe.begin();
+#endif
+#if METRICS_ENABLED
+    metricsServer.on("/metrics", HTTP_GET, handleMetrics);
+    metricsServer.begin();
+#endif
+  }
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+  // first sample as soon as the gas reference is ready, not a full sampling period after boot
+  lastSensorSample = millis() - SENSOR_SAMPLING_PERIOD;
+#endif
+  if (offlineMode) {
+    sendBootProfile();
   }
 #if defined(ARDUINO_ARCH_ESP32)
   rgbLedWrite(LED_BUILTIN, 0, 0, 0);
@@ -160,7 +176,7 @@ bool isButtonHeldAtBoot() {
   display.println("TO ENTER");
   display.println("");
   display.println("OFFLINE MODE");
-  display.display();
+  displayController.show();
   if (digitalRead(OLED_BUTTON_PIN) != LOW) {
     return false;
   }
@@ -169,13 +185,40 @@ bool isButtonHeldAtBoot() {
     if (digitalRead(OLED_BUTTON_PIN) != LOW) {
       return false;
     }
+    runBootTasks();
     delay(10);
   }
   return true;
 }
 
+// Boot phases that need neither the network nor the user, run while the offline mode button is held.
+// A normal boot doesn't wait for the button: the config is loaded before bootstrapSetup() and the gas burn-in runs in the loop.
+void runBootTasks() {
+  loadStoredConfig();
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+  if (readGas) {
+    getGasReference();
+    if (!readGas) bootProfiler.mark("gasReference");
+  }
+#endif
+}
+
+void loadStoredConfig() {
+  static bool loaded = false;
+  if (loaded) return;
+  loaded = true;
+  readConfigFromStorage();
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+  readClimateUnits();
+#endif
+  bootProfiler.mark("config");
+}
+
 /********************************** MANAGE WIFI AND MQTT DISCONNECTION *****************************************/
 void manageDisconnections() {
+  // the bootstrapper shows the reconnection status on the display
+  displayController.setPower(true);
+  displayController.forgetFrame();
   // shut down if wifi disconnects
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
   furnance = OFF_CMD;
@@ -187,46 +230,100 @@ void manageDisconnections() {
 
 /********************************** MQTT SUBSCRIPTIONS *****************************************/
 void manageQueueSubscription() {
-  BootstrapManager::subscribe(SMARTOSTAT_CLIMATE_STATE_TOPIC);
-  BootstrapManager::subscribe(UPS_STATE);
-  BootstrapManager::subscribe(GLOWORM_FRAMERATE);
-  BootstrapManager::subscribe(LUCIFERIN_FRAMERATE);
+  deviceMetrics.mqttConnections++;
+  const char *const topics[] = {
+    SMARTOSTAT_CLIMATE_STATE_TOPIC,
+    UPS_STATE,
+    GLOWORM_FRAMERATE,
+    LUCIFERIN_FRAMERATE,
 #if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
-  BootstrapManager::subscribe(SMARTOSTAT_SENSOR_STATE_TOPIC);
-  BootstrapManager::subscribe(SMARTOSTAT_STATE_TOPIC);
-  BootstrapManager::subscribe(SMARTOSTAT_FURNANCE_STATE_TOPIC);
-  BootstrapManager::subscribe(SMARTOSTAT_PIR_STATE_TOPIC);
-  BootstrapManager::subscribe(SMARTOSTATAC_CMD_TOPIC);
-  BootstrapManager::subscribe(SMARTOSTATAC_STAT_IRSEND);
-  BootstrapManager::subscribe(SMARTOLED_CMND_REBOOT);
-  BootstrapManager::subscribe(SPOTIFY_STATE_TOPIC);
+    SMARTOSTAT_SENSOR_STATE_TOPIC,
+    SMARTOSTAT_STATE_TOPIC,
+    SMARTOSTAT_FURNANCE_STATE_TOPIC,
+    SMARTOSTAT_PIR_STATE_TOPIC,
+    SMARTOSTATAC_CMD_TOPIC,
+    SMARTOSTATAC_STAT_IRSEND,
+    SMARTOLED_CMND_REBOOT,
+    SPOTIFY_STATE_TOPIC,
+    CMND_IR_RECEV,
 #endif
-  BootstrapManager::subscribe(SMARTOLED_CMND_TOPIC);
-  BootstrapManager::subscribe(SMARTOSTAT_FURNANCE_CMND_TOPIC);
+    SMARTOLED_CMND_TOPIC,
+    SMARTOSTAT_FURNANCE_CMND_TOPIC,
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-  BootstrapManager::subscribe(SMARTOSTAT_CMND_REBOOT);
-  BootstrapManager::subscribe(SMARTOSTATAC_CMND_IRSENDSTATE);
-  BootstrapManager::subscribe(SMARTOSTATAC_CMND_IRSEND);
-  BootstrapManager::subscribe(TOGGLE_BEEP);
+    SMARTOSTAT_CMND_REBOOT,
+    SMARTOSTATAC_CMND_IRSENDSTATE,
+    SMARTOSTATAC_CMND_IRSEND,
+    // CMND_IR_RECEV and TOGGLE_BEEP
+    IR_RECEV_CMND_TOPICS,
+    SMARTOSTATAC_CMND_UNITS,
+    SMARTOSTATAC_UNIT_CMND_IRSENDSTATE,
+    SMARTOSTATAC_UNIT_CMND_IRSEND,
 #endif
-  BootstrapManager::subscribe(SOLAR_STATION_POWER_STATE);
-  BootstrapManager::subscribe(SOLAR_STATION_PUMP_POWER);
-  BootstrapManager::subscribe(SOLAR_STATION_STATE);
-  BootstrapManager::subscribe(SOLAR_STATION_REMAINING_SECONDS);
-  BootstrapManager::subscribe(CMND_IR_RECEV);
+    // SOLAR_STATION_POWER_STATE
+    SOLAR_STATION_STAT_TOPICS,
+    SOLAR_STATION_STATE,
+    SOLAR_STATION_REMAINING_SECONDS,
+    SOLAR_STATION_PUMP_POWER
+  };
+  const uint8_t topicsCount = sizeof(topics) / sizeof(topics[0]);
+  // the rooms shown by the smartoled go in the same SUBSCRIBE packet
+  const char *batch[topicsCount + ROOM_SUBSCRIPTIONS];
+  memcpy(batch, topics, sizeof(topics));
+  uint8_t batchCount = topicsCount + addRoomSubscriptions(batch + topicsCount);
+  if (!subscribeBatch(batch, batchCount)) {
+    for (uint8_t i = 0; i < batchCount; i++) {
+      BootstrapManager::subscribe(batch[i]);
+    }
+  }
 
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-  BootstrapManager::publish(SMARTOSTAT_HELLO_TOPIC, "HELLO", true);
+  publishMqtt(SMARTOSTAT_HELLO_TOPIC, "HELLO", true);
+  sendClimateUnitsState();
 #endif
 #if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
-  BootstrapManager::publish(SMARTOLED_HELLO_TOPIC, "HELLO", true);
+  publishMqtt(SMARTOLED_HELLO_TOPIC, "HELLO", true);
 #endif
 
 }
 
+// Subscribe to every topic with a single SUBSCRIBE packet (QoS 0), PubSubClient sends one packet per topic
+bool subscribeBatch(const char *const *topics, uint8_t count) {
+  // 5 bytes reserved for the fixed header, written right before the variable header once the length is known
+  static uint8_t packet[MQTT_MAX_PACKET_SIZE];
+  static uint16_t packetId = 0;
+  if (!mqttClient.connected()) return false;
+  size_t pos = 5;
+  packetId = (packetId == 0xFFFF) ? 1 : packetId + 1;
+  packet[pos++] = packetId >> 8;
+  packet[pos++] = packetId & 0xFF;
+  for (uint8_t i = 0; i < count; i++) {
+    size_t topicLength = strlen(topics[i]);
+    if (pos + 2 + topicLength + 1 > sizeof(packet)) return false;
+    packet[pos++] = topicLength >> 8;
+    packet[pos++] = topicLength & 0xFF;
+    memcpy(packet + pos, topics[i], topicLength);
+    pos += topicLength;
+    packet[pos++] = 0; // requested QoS
+  }
+  // remaining length, variable length encoding
+  size_t remainingLength = pos - 5;
+  uint8_t encodedLength[4];
+  uint8_t encodedBytes = 0;
+  do {
+    uint8_t digit = remainingLength % 128;
+    remainingLength /= 128;
+    if (remainingLength > 0) digit |= 0x80;
+    encodedLength[encodedBytes++] = digit;
+  } while (remainingLength > 0);
+  size_t start = 5 - 1 - encodedBytes;
+  packet[start] = 0x82; // SUBSCRIBE, reserved flags 0010
+  memcpy(packet + start + 1, encodedLength, encodedBytes);
+  return mqttClient.write(packet + start, pos - start) == pos - start;
+}
+
 /********************************** MANAGE HARDWARE BUTTON *****************************************/
 void manageHardwareButton() {
-#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+  if (!Target::HAS_CLIMATE_CONTROL) return;
   // Touch button management features
   if (digitalRead(OLED_BUTTON_PIN) == HIGH) {
     lastButtonPressed = OLED_BUTTON_PIN;
@@ -237,68 +334,238 @@ void manageHardwareButton() {
   } else {
     touchButtonManagement(LOW);
   }
-#endif
 }
 
 /********************************** START CALLBACK *****************************************/
+// Decode the topic and queue the raw message, payloads are parsed and executed from the main loop by processInboundQueue()
 void callback(char *topic, byte *payload, unsigned int length) {
-  JsonDocument json = bootstrapManager.parseQueueMsg(topic, payload, length);
-
-  if (strcmp(topic, SMARTOSTAT_SENSOR_STATE_TOPIC) == 0) {
-    processSmartostatSensorJson(json);
-  } else if (strcmp(topic, SMARTOSTAT_STATE_TOPIC) == 0) {
-    processSmartostatSensorJson(json);
-  } else if (strcmp(topic, SMARTOSTAT_CLIMATE_STATE_TOPIC) == 0) {
-    processSmartostatClimateJson(json);
-  } else if (strcmp(topic, UPS_STATE) == 0) {
-    processUpsStateJson(json);
-  }  else if (strcmp(topic, SMARTOSTAT_PIR_STATE_TOPIC) == 0) {
-    processSmartostatPirState(json);
-  } else if (strcmp(topic, SMARTOLED_CMND_TOPIC) == 0) {
-    processSmartoledCmnd(json);
-  } else if (strcmp(topic, SMARTOSTAT_FURNANCE_CMND_TOPIC) == 0) {
-    processFurnancedCmnd(json);
-  } else if (strcmp(topic, SOLAR_STATION_POWER_STATE) == 0) {
-    processSolarStationPowerState(json);
-  } else if (strcmp(topic, SOLAR_STATION_PUMP_POWER) == 0) {
-    processSolarStationWaterPump(json);
-  } else if (strcmp(topic, SOLAR_STATION_STATE) == 0) {
-    processSolarStationState(json);
-  } else if (strcmp(topic, SOLAR_STATION_REMAINING_SECONDS) == 0) {
-    processSolarStationRemainingSeconds(json);
-  } else if (strcmp(topic, CMND_IR_RECEV) == 0) {
-    processIrRecev(json);
-  } else if (strcmp(topic, GLOWORM_FRAMERATE) == 0) {
-    processSmartoledGlowWormFramerate(json);
-  } else if (strcmp(topic, LUCIFERIN_FRAMERATE) == 0) {
-    processSmartoledFramerate(json);
+  deviceMetrics.mqttReceived++;
+  serialTrace.mqtt(TRACE_MQTT_IN, topic, length);
+  size_t fullLength = payloadSizeProbe.take();
+  if (fullLength > length) {
+    // PubSubClient truncated it to its buffer
+    inboundOversized++;
+    inboundOversizedBytes = fullLength;
+    strlcpy(inboundOversizedTopic, topic, sizeof(inboundOversizedTopic));
+    return;
+  }
+  int route = findInboundRoute(topic);
+  if (route < 0) {
+    inboundUnrouted++;
+    return;
+  }
+  InboundTopicStats &stats = inboundStats[route];
+  stats.messages++;
+  stats.bytes += length;
+  stats.lastSeen = millis();
+  if (!inboundRoutes[route].alwaysProcess) {
+    // retained states are often republished unchanged, nothing to do if the payload is the same
+    uint32_t fingerprint = payloadFingerprint(payload, length);
+    InboundTopicState &state = inboundTopics[route];
+    if (state.fingerprinted && state.fingerprint == fingerprint) {
+      inboundDuplicates++;
+      return;
+    }
+    state.fingerprint = fingerprint;
+    state.fingerprinted = true;
+  }
+  if (inboundRoutes[route].priority == PRIORITY_LATEST) {
+    // latest value wins, overwrite the mailbox without parsing
+    InboundTopicState &mailbox = inboundTopics[route];
+    if (mailbox.latestPending) inboundSuperseded++;
+    mailbox.latest = EMPTY_STR;
+    mailbox.latest.concat(reinterpret_cast<const char *>(payload), length);
+    mailbox.latestReceivedAt = millis();
+    mailbox.latestPending = true;
+    return;
+  }
+  bool actuator = inboundRoutes[route].priority == PRIORITY_ACTUATOR;
+  if (actuator && (actuatorQueue.full() || inboundQueuedBytes + length > INBOUND_QUEUE_BYTES)) {
+    // never execute a command here, reject the new one and let the sender see it unacknowledged
+    inboundRejected++;
+    inboundTopics[route].fingerprinted = false;
+    return;
   }
+  if (!actuator) {
+    // display updates are superseded by newer ones, drop the oldest until the new one fits
+    while (!displayQueue.empty() && (displayQueue.full() || inboundQueuedBytes + length > INBOUND_QUEUE_BYTES)) {
+      InboundCommand oldest;
+      displayQueue.pop(oldest);
+      inboundQueuedBytes -= oldest.payload.length();
+      inboundDropped++;
+      // the dropped payload has never been executed, don't let its fingerprint filter a resend
+      inboundTopics[oldest.route].fingerprinted = false;
+    }
+    if (inboundQueuedBytes + length > INBOUND_QUEUE_BYTES) {
+      inboundDropped++;
+      inboundTopics[route].fingerprinted = false;
+      return;
+    }
+  }
+  InboundCommand command;
+  command.route = route;
+  command.receivedAt = millis();
+  command.payload.concat(reinterpret_cast<const char *>(payload), length);
+  inboundQueuedBytes += length;
+  if (strchr(inboundRoutes[route].topic, '+') != nullptr) {
+    command.topic = topic;
+  }
+  if (actuator) {
+    actuatorQueue.push(std::move(command));
+  } else {
+    displayQueue.push(std::move(command));
+  }
+}
 
-#if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
-  if (strcmp(topic, SMARTOSTATAC_CMD_TOPIC) == 0) {
-    processSmartostatAcJson(json);
-  } else if (strcmp(topic, SMARTOSTAT_FURNANCE_STATE_TOPIC) == 0) {
-    processSmartostatFurnanceState(json);
-  } else if (strcmp(topic, SMARTOSTATAC_STAT_IRSEND) == 0) {
-    processACState(json);
-  } else if (strcmp(topic, SMARTOLED_CMND_REBOOT) == 0) {
-    processSmartoledRebootCmnd(json);
-  } else if (strcmp(topic, SPOTIFY_STATE_TOPIC) == 0) {
-    processSpotifyStateJson(json);
+int findInboundRoute(const char *topic) {
+  for (uint8_t i = 0; i < inboundRoutesCount; i++) {
+    if (topicMatches(inboundRoutes[i].topic, topic)) {
+      return i;
+    }
   }
-#endif
+  return -1;
+}
 
-#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-  if (strcmp(topic, SMARTOSTATAC_CMND_IRSENDSTATE) == 0) {
-    processIrOnOffCmnd(json);
-  } else if (strcmp(topic, SMARTOSTATAC_CMND_IRSEND) == 0) {
-    processIrSendCmnd(json);
-  } else if (strcmp(topic, SMARTOSTAT_CMND_REBOOT) == 0) {
-    processSmartostatRebootCmnd(json);
-  } else if (strcmp(topic, TOGGLE_BEEP) == 0) {
-    toggleBeep(json);
+// MQTT topic filter matching, '+' matches a single level
+bool topicMatches(const char *filter, const char *topic) {
+  while (*filter && *topic) {
+    if (*filter == '+') {
+      while (*topic && *topic != '/') topic++;
+      filter++;
+    } else if (*filter++ != *topic++) {
+      return false;
+    }
   }
-#endif
+  return *filter == *topic;
+}
+
+// 32 bit FNV-1a
+uint32_t payloadFingerprint(const byte *payload, unsigned int length) {
+  uint32_t hash = 2166136261UL;
+  for (unsigned int i = 0; i < length; i++) {
+    hash ^= payload[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+// Execute queued messages, actuator commands first, then the mailboxes, until the loop budget is spent
+void processInboundQueue() {
+  unsigned long start = millis();
+  InboundCommand command;
+  while (millis() - start < INBOUND_BUDGET_MS) {
+    if (!actuatorQueue.pop(command) && !displayQueue.pop(command)) {
+      break;
+    }
+    inboundQueuedBytes -= command.payload.length();
+    cpuGovernor.boost();
+    executeInbound(command);
+  }
+  processInboundMailboxes(start);
+}
+
+// Values the renderer needs right now, the others stay in their mailbox until they are shown
+bool isInboundRendered(uint8_t route) {
+  const char *topic = inboundRoutes[route].topic;
+  if (topic == LUCIFERIN_FRAMERATE || topic == GLOWORM_FRAMERATE) {
+    return currentPage == 7;
+  }
+  if (topic == SOLAR_STATION_REMAINING_SECONDS) {
+    return wpTriggered;
+  }
+  return true;
+}
+
+// Parse the latest payload of the mailboxes the renderer needs until the budget started at budgetStart is spent.
+// Called by the loop, so the values used with the display off are fresh too, and once per frame before drawing.
+void processInboundMailboxes(unsigned long budgetStart) {
+  for (uint8_t i = 0; i < inboundRoutesCount; i++) {
+    if (millis() - budgetStart >= INBOUND_BUDGET_MS) return;
+    // round robin, a slow mailbox can't starve the next ones
+    uint8_t route = inboundMailboxCursor;
+    inboundMailboxCursor = (inboundMailboxCursor + 1) % inboundRoutesCount;
+    InboundTopicState &mailbox = inboundTopics[route];
+    if (!mailbox.latestPending || !isInboundRendered(route)) continue;
+    cpuGovernor.boost();
+    InboundCommand command;
+    command.route = route;
+    command.receivedAt = mailbox.latestReceivedAt;
+    command.payload = mailbox.latest;
+    mailbox.latest = EMPTY_STR;
+    mailbox.latestPending = false;
+    executeInbound(command);
+  }
+}
+
+// Parse and execute a message, called within the loop budget
+void executeInbound(InboundCommand &command) {
+  const InboundRoute &route = inboundRoutes[command.route];
+  InboundTopicStats &stats = inboundStats[command.route];
+  inboundTopic = (command.topic.length() > 0) ? command.topic.c_str() : route.topic;
+  inboundReceivedAt = command.receivedAt;
+  unsigned long parseStart = micros();
+  byte *payload = reinterpret_cast<byte *>(const_cast<char *>(command.payload.c_str()));
+  JsonDocument json = bootstrapManager.parseQueueMsg(const_cast<char *>(inboundTopic), payload, command.payload.length());
+  unsigned long handlerStart = micros();
+  stats.parseMicros += handlerStart - parseStart;
+  if (isParseFailure(payload, command.payload.length(), json)) stats.parseFailures++;
+  // the document holds its own copy of the strings
+  command.payload = EMPTY_STR;
+  commandTrace.receivedAt = command.receivedAt;
+  commandTrace.actuatedAt = 0;
+  commandTrace.correlationId = json[CORRELATION_ID] | EMPTY_STR;
+  route.handler(std::move(json));
+  stats.handlerMicros += micros() - handlerStart;
+  inboundTopic = nullptr;
+}
+
+// parseQueueMsg() wraps a payload that isn't JSON into {"VALUE": payload}, it's a failure if it looked like JSON
+bool isParseFailure(const byte *payload, unsigned int length, JsonDocument &json) {
+  if (length == 0 || payload[0] != '{') return false;
+  if (json.isNull()) return true;
+  if (json.size() != 1 || !json[VALUE].is<const char *>()) return false;
+  const char *value = json[VALUE];
+  return strlen(value) == length && memcmp(value, payload, length) == 0;
+}
+
+// Per topic ingest statistics, split in as many messages as needed to fit MQTT_MAX_PACKET_SIZE.
+// Every topic is [messages, bytes, parse us, handler us, parse failures, seconds since the last message].
+void sendIngestState() {
+  const size_t maxPayload = MQTT_MAX_PACKET_SIZE / 2;
+  uint8_t route = 0;
+  uint8_t part = 0;
+  while (route < inboundRoutesCount || part == 0) {
+    JsonDocument doc;
+    JsonObject root = doc.to<JsonObject>();
+    root["part"] = part;
+    if (part == 0) {
+      root["oversized"] = inboundOversized;
+      root["oversizedBytes"] = inboundOversizedBytes;
+      root["oversizedTopic"] = inboundOversizedTopic;
+      root["bufferSize"] = mqttClient.getBufferSize();
+      root["unrouted"] = inboundUnrouted;
+      root["rejected"] = inboundRejected;
+    }
+    JsonObject topics = root["topics"].to<JsonObject>();
+    for (; route < inboundRoutesCount && measureJson(doc) < maxPayload; route++) {
+      const InboundTopicStats &stats = inboundStats[route];
+      if (stats.messages == 0) continue;
+      JsonArray topic = topics[inboundRoutes[route].topic].to<JsonArray>();
+      topic.add(stats.messages);
+      topic.add(stats.bytes);
+      topic.add(stats.parseMicros);
+      topic.add(stats.handlerMicros);
+      topic.add(stats.parseFailures);
+      topic.add((millis() - stats.lastSeen) / 1000);
+    }
+    root["last"] = route >= inboundRoutesCount;
+    publishMqtt(INGEST_STATE_TOPIC, root, false);
+    part++;
+  }
+}
+
+void markActuated() {
+  commandTrace.actuatedAt = millis();
 }
 
 inline bool isCenterLogoActive() {
@@ -309,6 +576,7 @@ void draw() {
   // pagina 0,1,2,3,4,5,6 sono fisse e sono temp, humidita, pressione, min-maximum, ups, spotify
   // lastPage contiene le info su smartoled
   yield();
+  processInboundMailboxes(millis());
 
   if (WiFi.status() == WL_CONNECTED || ethConnected) {
     if (furnanceTriggered) {
@@ -331,13 +599,23 @@ void draw() {
       return;
     }
 
-    if (currentPage == 8) {
-      if (spotifyActivity != SPOTIFY_PLAYING) {
+    if (currentPage == 8 && !mediaPlaying()) {
+      currentPage = ROOMS_PAGE;
+    }
+    if (currentPage == ROOMS_PAGE) {
+#if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
+      if (roomsCount() > 1) {
         display.clearDisplay();
-        currentPage = numPages;
-        bootstrapManager.drawInfoPage(VERSION, AUTHOR);
+        drawRoomsPage();
+        displayController.show();
         return;
       }
+#endif
+      display.clearDisplay();
+      currentPage = numPages;
+      bootstrapManager.drawInfoPage(VERSION, AUTHOR);
+      displayController.forgetFrame();
+      return;
     }
 
     if (currentPage != numPages && currentPage != 8) {
@@ -468,104 +746,69 @@ void draw() {
       display.setTextSize(1);
       display.print(F("KOhms"));
     } else if (currentPage == 4) {
-      display.setCursor(40, 25);
-      display.print(IAQ, 1);
-      display.setTextSize(1);
-      display.print(F("IAQ"));
+      // IAQ from the BME680, CO2 from the SCD4x, whichever is present
+      if (IAQ != -100.0f) {
+        display.setCursor(40, 25);
+        display.print(IAQ, 1);
+        display.setTextSize(1);
+        display.print(F("IAQ"));
+        if (co2 != -100.0f) {
+          display.setCursor(40, 44);
+          display.print(co2, 0);
+          display.print(F("ppm CO2"));
+        }
+      } else if (co2 != -100.0f) {
+        display.setCursor(40, 25);
+        display.print(co2, 0);
+        display.setTextSize(1);
+        display.print(F("ppm"));
+      }
     } else if (currentPage == 5) {
       display.setTextSize(1);
 
       display.setCursor(8, 47);
-      display.print(minTemperature, 1);
+      display.print(dailyMin(temperatureStats), 1);
       display.println(F("C"));
       display.setCursor(8, 57);
-      display.print(maxTemperature, 1);
+      display.print(dailyMax(temperatureStats), 1);
       display.println(F("C"));
 
       display.setCursor(50, 47);
-      display.print(minHumidity, 1);
+      display.print(dailyMin(humidityStats), 1);
       display.println(F("%"));
       display.setCursor(50, 57);
-      display.print(maxHumidity, 1);
+      display.print(dailyMax(humidityStats), 1);
       display.println(F("%"));
 
       display.setCursor(90, 47);
-      display.print(minPressure, 1);
+      display.print(dailyMin(pressureStats), 1);
       display.setCursor(90, 57);
-      display.print(maxPressure, 1);
+      display.print(dailyMax(pressureStats), 1);
     } else if (currentPage == 6) {
       display.setTextSize(1);
 
       display.setCursor(10, 47);
-      display.print(minGasResistance, 0);
+      display.print(dailyMin(gasResistanceStats), 0);
       display.println(F("KOhms"));
       display.setCursor(10, 57);
-      display.print(maxGasResistance, 0);
+      display.print(dailyMax(gasResistanceStats), 0);
       display.println(F("KOhms"));
 
       display.setCursor(75, 47);
-      display.print(minIAQ, 0);
+      display.print(dailyMin(IAQStats), 0);
       display.println(F("IAQ"));
       display.setCursor(75, 57);
-      display.print(maxIAQ, 0);
+      display.print(dailyMax(IAQStats), 0);
       display.println(F("IAQ"));
     } else if (currentPage == 7) {
       display.setCursor(55, 25);
       display.print(loadwatt);
       display.print(F("W"));
     } else if (currentPage == 8) {
-      if (spotifyActivity == SPOTIFY_PLAYING) {
-        display.clearDisplay();
-        // display.fillTriangle(2, 8, 7, 3, 12, 8, WHITE);
-        display.fillTriangle(0, 0, 4, 4, 0, 8, WHITE);
-        if (appName == BT_AUDIO) {
-          display.drawBitmap((display.width() / 2) - (youtubeLogoW / 2), 0, youtubeLogo, youtubeLogoW, youtubeLogoH, 1);
-        } else {
-          display.drawBitmap((display.width() / 2) - (spotifyLogoW / 2), 0, spotifyLogo, spotifyLogoW, spotifyLogoH, 1);
-        }
-        display.setTextSize(2);
-        display.setTextWrap(false);
-
-        // 12 is the text width
-        int titleLen = mediaTitle.length() * 12;
-        if (-titleLen > offset) {
-          offset = 160;
-        } else {
-          offset -= 2;
-        }
-        display.setCursor(offset,spotifyLogoW + 5);
-
-        display.println(mediaTitle);
-
-        // 6 is the text width
-        int authorLen = mediaArtist.length() * 6;
-        if (authorLen > 128) {
-          if (-authorLen > offsetAuthor) {
-            offsetAuthor = 130;
-          } else {
-            offsetAuthor -= 1;
-          }
-        } else {
-          offsetAuthor = 0;
-        }
-        display.setTextSize(1);
-        display.setCursor(offsetAuthor, 47);
-        display.println(mediaArtist);
-
-        // float roundedVolumeLevel = volumeLevel.toFloat();
-        // int volume = (roundedVolumeLevel > 0.99) ? display.width() : ((roundedVolumeLevel*100)*1.28);
-        // draw position bar
-        float currentMediaDuration = mediaDuration.toFloat();
-        float currentMediaPosition = mediaPosition.toFloat();
-        int position = 0;
-        if (currentMediaDuration > 0.01f) {
-          position = ((currentMediaPosition * 100.0f) / currentMediaDuration) * 1.28f;
-        }
-        display.drawRect(0, (display.height() - 4), display.width(), 4, WHITE);
-        display.fillRect(0, (display.height() - 4), position, 4, WHITE);
-      }
+      drawMediaPage();
     } else if (currentPage == numPages) {
       bootstrapManager.drawInfoPage(VERSION, AUTHOR);
+      displayController.forgetFrame();
     }
     display.setTextWrap(true);
 
@@ -579,6 +822,7 @@ void draw() {
     }
 
     bootstrapManager.drawScreenSaver("DPsoftware domotics");
+    if (screenSaverTriggered) displayController.forgetFrame();
 
     yield();
 
@@ -587,14 +831,14 @@ void draw() {
     }
 
     if (wpTriggered) {
-      if (solarStationRemainingSeconds == "0") {
+      if (waterPumpClock.isSynced() && waterPumpClock.remaining() <= 0) {
         wpTriggered = false;
       }
       drawWPRemainingSeconds(WATER_PUMP_LOGO, WATER_PUMP_LOGO_W, WATER_PUMP_LOGO_H);
     }
 
     if (temperature != -100.f) {
-      display.display();
+      displayController.show();
     }
 
     /*Serial.print(F("Temp: "); Serial.print(temperature); Serial.println(F("°C");
@@ -707,7 +951,7 @@ void drawCenterScreenLogo(const unsigned char *logo, const int logoW, const int
     (display.width() - logoW) / 2,
     (display.height() - logoH) / 2,
     logo, logoW, logoH, 1);
-  display.display();
+  displayController.show();
 }
 
 void drawSolarStationTrigger(const unsigned char *logo, const int logoW, const int logoH) {
@@ -725,8 +969,10 @@ void drawWPRemainingSeconds(const unsigned char *logo, const int logoW, const in
     logo, logoW, logoH, 1);
   display.setCursor(70, 22);
   display.setTextSize(3);
-  display.print(solarStationRemainingSeconds);
-  display.display();
+  if (waterPumpClock.isSynced()) {
+    display.print((int) ceilf(waterPumpClock.remaining()));
+  }
+  displayController.show();
 }
 
 void drawRoundRect() {
@@ -741,11 +987,9 @@ void drawRoundRect() {
 bool processUpsStateJson(JsonDocument json) {
   if (json["runtime"].is<JsonVariant>()) {
     float loadFloat = json["load"];
-#if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
-    if (loadFloat > HIGH_WATT && loadFloatPrevious < HIGH_WATT) {
+    if (Target::WAKES_ON_HIGH_LOAD && loadFloat > HIGH_WATT && loadFloatPrevious < HIGH_WATT) {
       currentPage = 7;
     }
-#endif
     loadFloatPrevious = loadFloat;
     if (loadwattMax < loadFloat) {
       loadwattMax = loadFloat;
@@ -763,33 +1007,38 @@ bool processUpsStateJson(JsonDocument json) {
 }
 
 bool processSmartostatSensorJson(JsonDocument json) {
-  if (json["BME680"].is<JsonVariant>()) {
-    float temperatureFloat = json["BME680"]["Temperature"];
-    temperature = temperatureFloat;
-    minTemperature = (temperatureFloat < minTemperature) ? temperatureFloat : minTemperature;
-    maxTemperature = (temperatureFloat > maxTemperature) ? temperatureFloat : maxTemperature;
-    float humidityFloat = json["BME680"]["Humidity"];
-    humidity = humidityFloat;
-    minHumidity = (humidityFloat < minHumidity) ? humidityFloat : minHumidity;
-    maxHumidity = (humidityFloat > maxHumidity) ? humidityFloat : maxHumidity;
-    float pressureFloat = json["BME680"]["Pressure"];
-    pressure = pressureFloat;
-    minPressure = (pressureFloat < minPressure) ? pressureFloat : minPressure;
-    maxPressure = (pressureFloat > maxPressure) ? pressureFloat : maxPressure;
-    float gasResistanceFloat = json["BME680"]["GasResistance"];
-    gasResistance = gasResistanceFloat;
-    minGasResistance = (gasResistanceFloat < minGasResistance) ? gasResistanceFloat : minGasResistance;
-    maxGasResistance = (gasResistanceFloat > maxGasResistance) ? gasResistanceFloat : maxGasResistance;
-    float IAQFloat = json["BME680"]["IAQ"];
-    IAQ = IAQFloat;
-    minIAQ = (IAQFloat < minIAQ) ? IAQFloat : minIAQ;
-    maxIAQ = (IAQFloat > maxIAQ) ? IAQFloat : maxIAQ;
+  SensorState sensor;
+  decodeJson(json.as<JsonObjectConst>(), sensor);
+  if (sensor.scd4x.present) {
+    co2 = sensor.scd4x.co2;
   }
+  if (sensor.bme680.present) {
+    temperature = sensor.bme680.temperature;
+    humidity = sensor.bme680.humidity;
+    pressure = sensor.bme680.pressure;
+    gasResistance = sensor.bme680.gasResistance;
+    IAQ = sensor.bme680.iaq;
+    addSensorStatistics(temperature, humidity, pressure, gasResistance, IAQ);
+  } else if (sensor.scd4x.present) {
+    // smartostat without a BME680, temperature and humidity are read by the SCD4x
+    temperature = sensor.scd4x.temperature;
+    humidity = sensor.scd4x.humidity;
+    uint32_t now = uptimeSeconds();
+    temperatureStats.add(temperature, now);
+    humidityStats.add(humidity, now);
+  } else {
+    return true;
+  }
+#if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
+  updateRoomSensor(temperature, humidity);
+#endif
   return true;
 }
 
 bool processSmartostatClimateJson(JsonDocument json) {
-  String timeConst = json["Time"];
+  ClimateState climate;
+  decodeJson(json.as<JsonObjectConst>(), climate);
+  String timeConst = climate.time;
   // On first boot the timedate variable is OFF
   if (timedate == OFF_CMD) {
     helper.setDateTime(timeConst);
@@ -797,6 +1046,9 @@ bool processSmartostatClimateJson(JsonDocument json) {
   } else {
     helper.setDateTime(timeConst);
   }
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+  checkAccountingDay();
+#endif
   // lastMQTTConnection and lastWIFiConnection are resetted on every disconnection
   if (lastMQTTConnection == OFF_CMD) {
     lastMQTTConnection = date + " " + currentime;
@@ -808,45 +1060,36 @@ bool processSmartostatClimateJson(JsonDocument json) {
   // if (hours == "23" && minutes == "59") {
   //   resetMinMaxValues();
   // }
-  haVersion = helper.getValue(json["haVersion"]);
-  humidityThreshold = json["humidity_threshold"];
-  tempSensorOffset = json["temp_sensor_offset"];
-  int brightness = json["brightness"];
-
-  display.ssd1306_command(0x81);
-  display.ssd1306_command(brightness); //min 10 max 255
-  display.ssd1306_command(0xD9);
-  if (brightness <= 80) {
-    display.ssd1306_command(31);
-  } else {
-    display.ssd1306_command(34);
-  }
+  haVersion = climate.haVersion;
+  humidityThreshold = climate.humidityThreshold;
+  tempSensorOffset = climate.tempSensorOffset;
+  int brightness = climate.brightness;
+
+  displayController.fadeContrast(brightness, 500); //min 10 max 255
+  displayController.setPrecharge((brightness <= 80) ? 31 : 34);
 
-  String operationModeHeatConst = helper.getValue(json["smartostat"]["hvac_action"]);
-  String operationModeCoolConst = helper.getValue(json["smartostatac"]["hvac_action"]);
+  String operationModeHeatConst = climate.smartostat.hvacAction;
+  String operationModeCoolConst = climate.smartostatac.hvacAction;
 
-  alarmo = helper.getValue(json["smartostat"]["alarmo"]);
-  fan = helper.getValue(json["smartostatac"]["fan"]);
+  alarmo = climate.smartostat.alarmo;
+  fan = climate.smartostatac.fan;
 
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+  heatingTarget = (operationModeHeatConst == HEAT || operationModeHeatConst == IDLE) ? climate.smartostat.temperature : NAN;
+#endif
   if (operationModeHeatConst == HEAT || operationModeHeatConst == IDLE) {
-    float target_temperatureFloat = json["smartostat"]["temperature"];
-    target_temperature = serialized(String(target_temperatureFloat, 1));
+    target_temperature = serialized(String(climate.smartostat.temperature, 1));
     hvac_action = HEAT;
-    const char *awayModeConst = json["smartostat"]["preset_mode"];
-    away_mode = (strcmp(awayModeConst, "away") == 0) ? ON_CMD : OFF_CMD;
+    away_mode = (strcmp(climate.smartostat.presetMode, "away") == 0) ? ON_CMD : OFF_CMD;
   } else if (operationModeCoolConst == COOL || operationModeCoolConst == IDLE) {
-    float target_temperatureFloat = json["smartostatac"]["temperature"];
-    target_temperature = serialized(String(target_temperatureFloat, 1));
+    target_temperature = serialized(String(climate.smartostatac.temperature, 1));
     hvac_action = COOL;
-    const char *awayModeConst = json["smartostatac"]["preset_mode"];
-    away_mode = (strcmp(awayModeConst, "away") == 0) ? ON_CMD : OFF_CMD;
+    away_mode = (strcmp(climate.smartostatac.presetMode, "away") == 0) ? ON_CMD : OFF_CMD;
   } else {
     if (temperature > HEAT_COOL_THRESHOLD) {
-      float target_temperatureFloat = json["smartostatac"]["temperature"];
-      target_temperature = serialized(String(target_temperatureFloat, 1));
+      target_temperature = serialized(String(climate.smartostatac.temperature, 1));
     } else {
-      float target_temperatureFloat = json["smartostat"]["temperature"];
-      target_temperature = serialized(String(target_temperatureFloat, 1));
+      target_temperature = serialized(String(climate.smartostat.temperature, 1));
     }
     hvac_action = OFF_CMD;
     away_mode = OFF_CMD;
@@ -855,52 +1098,6 @@ bool processSmartostatClimateJson(JsonDocument json) {
   return true;
 }
 
-bool processSpotifyStateJson(JsonDocument json) {
-  //serializeJsonPretty(json, Serial); Serial.println();
-  if (json["media_artist"].is<JsonVariant>()) {
-    spotifyActivity = helper.getValue(json["spotify_activity"]);
-    mediaTitle = helper.getValue(json["media_title"]);
-    spotifySource = helper.getValue(json["spotifySource"]);
-    volumeLevel = helper.getValue(json["volume_level"]);
-    mediaDuration = helper.getValue(json["media_duration"]);
-    mediaPosition = helper.getValue(json["media_position"]);
-    mediaArtist = helper.getValue(json["media_artist"]);
-    appName = helper.getValue(json["app_name"]);
-    spotifyPosition = helper.getValue(json["position"]);
-
-    if (appName != BT_AUDIO) {
-      if ((spotifyActivity == SPOTIFY_PAUSED || spotifyActivity == SPOTIFY_IDLE) && mediaTitle == mediaTitlePrevious) {
-        cleanSpotifyInfo();
-      }
-      if ((mediaTitle != mediaTitlePrevious) && (mediaTitlePrevious != OFF_CMD) && (mediaTitle != BT_AUDIO)) {
-        currentPage = 8;
-      }
-    } else if (spotifyPosition != spotifyPositionPrevious) {
-      spotifyActivity = SPOTIFY_PLAYING;
-      if (mediaTitle != mediaTitlePrevious && (mediaTitle != BT_AUDIO)) {
-        currentPage = 8;
-      }
-    } else {
-      spotifyActivity = SPOTIFY_IDLE;
-      cleanSpotifyInfo();
-    }
-
-    mediaTitlePrevious = helper.getValue(json["media_title"]);
-    spotifyPositionPrevious = helper.getValue(json["position"]);
-  }
-  return true;
-}
-
-void cleanSpotifyInfo() {
-  mediaTitle = EMPTY_STR;
-  mediaArtist = EMPTY_STR;
-  spotifySource = EMPTY_STR;
-  volumeLevel = EMPTY_STR;
-  mediaDuration = EMPTY_STR;
-  mediaPosition = EMPTY_STR;
-  appName = EMPTY_STR;
-}
-
 bool processSolarStationPowerState(JsonDocument json) {
   String solarStation = json["state"];
   if (solarStation == ON_CMD && stateOn) {
@@ -917,6 +1114,8 @@ bool processSolarStationPowerState(JsonDocument json) {
 bool processSolarStationWaterPump(JsonDocument json) {
   String waterPump = helper.isOnOff(json);
   if (waterPump == ON_CMD) {
+    // wait for the first countdown update of this run
+    waterPumpClock.clear();
     wpTriggered = true;
     stateOn = true;
     sendPowerState();
@@ -935,7 +1134,7 @@ bool processSolarStationState(JsonDocument json) {
 }
 
 bool processSolarStationRemainingSeconds(JsonDocument json) {
-  solarStationRemainingSeconds = helper.getValue(json["remaining_seconds"]);
+  waterPumpClock.sync(0, helper.getValue(json["remaining_seconds"]).toFloat(), true, inboundReceivedAt);
   return true;
 }
 
@@ -969,16 +1168,19 @@ bool processSmartostatAcJson(JsonDocument json) {
 
 bool processFurnancedCmnd(JsonDocument json) {
   furnance = helper.isOnOff(json);
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+  // switch the relay first, acknowledgements can wait
+  releManagement();
+  markActuated();
+#endif
   if (furnance == ON_CMD) {
     furnanceTriggered = true;
     stateOn = true;
     sendPowerState();
-    delay(DELAY_200);
   }
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
   sendFurnanceState();
-  delay(DELAY_200);
-  releManagement();
+  sendCommandLatency(SMARTOSTAT_FURNANCE_CMND_TOPIC);
 #endif
   return true;
 }
@@ -991,11 +1193,13 @@ bool processIrRecev(JsonDocument json) {
 // IRSEND MQTT message ON OFF only for Smartostat
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
 bool toggleBeep(JsonDocument json) {
-  acir.stateReset();
-  acir.setBeep(true);
-  acir.off();
-  acir.send();
-  acir.stateReset();
+  stdAc::state_t state = climateUnits[PRIMARY_AC].desired;
+  state.power = false;
+  state.beep = true;
+  {
+    CpuTransmitScope transmit(cpuGovernor);
+    irac.sendAc(state, nullptr);
+  }
 #if defined(ESP8266)
   EspClass::restart();
 #else
@@ -1013,7 +1217,7 @@ bool processSmartostatRebootCmnd(JsonDocument json) {
     sendFurnanceState();
     ac = OFF_CMD;
     sendACState();
-    BootstrapManager::publish(SMARTOSTAT_PIR_STATE_TOPIC, OFF_CMD.c_str(), true);
+    publishMqtt(SMARTOSTAT_PIR_STATE_TOPIC, OFF_CMD.c_str(), true);
     releManagement();
     acManagement();
     sendSmartostatRebootCmnd();
@@ -1029,77 +1233,198 @@ bool processIrOnOffCmnd(JsonDocument json) {
   if (acState == ON_CMD && ac == OFF_CMD) {
     acTriggered = true;
     ac = ON_CMD;
-    acir.on();
-    acir.setFan(kSamsungAcFanLow);
-    acir.setMode(kSamsungAcCool);
-    acir.setTemp(20);
-    acir.setSwing(false);
-    acir.sendExtended(IR_RETRY);
+    sendAcPower(true);
+    markActuated();
     sendACState();
+    sendCommandLatency(SMARTOSTATAC_CMND_IRSENDSTATE);
   } else if (acState == OFF_CMD) {
-    // set power mode before shutdown, if you don't do this sometimes the off command does not work
-    if (stateOn) {
-      // ac = ON_CMD;
-      // acir.on();
-      // acir.setMode(kSamsungAcCool);
-      // acir.setTemp(28);
-      // acir.setPowerful(true);
-      // acir.setSwing(false);
-      // acir.setQuiet(false);
-      // acir.send(IR_RETRY);
-      // delay(200);
-    }
     ac = OFF_CMD;
-    acir.stateReset();
-    acir.off();
-    yield();
-    acir.sendOff(IR_RETRY);
-    delay(200);
+    sendAcPower(false);
+    markActuated();
     sendACState();
+    sendCommandLatency(SMARTOSTATAC_CMND_IRSENDSTATE);
   }
-  //Serial.printf("  %s\n", acir.toString().c_str());
   return true;
 }
 
 bool processIrSendCmnd(JsonDocument json) {
-  acir.on();
-  if (json["alette_ac"].is<JsonVariant>()) {
-    acir.setMode(kSamsungAcCool);
-
-    const char *tempConst = json["temp"];
-    uint8_t tempInt = atoi(tempConst);
-
-    acir.setTemp(tempInt);
-
-    String alette = json["alette_ac"];
-    acir.setQuiet(false);
-    acir.setPowerful(false);
-    if (alette == off_CMD) {
-      acir.setSwing(false);
-      String modeConst = json["mode"];
-      if (FAN_LOW == modeConst) {
-        acir.setFan(kSamsungAcFanLow);
-      } else if (FAN_POWER == modeConst) {
-        acir.setPowerful(true);
-      } else if (FAN_QUIET == modeConst) {
-        acir.setQuiet(true);
-      } else if (FAN_AUTO == modeConst) {
-        acir.setFan(kSamsungAcFanAuto);
-      } else if (FAN_HIGH == modeConst) {
-        acir.setFan(kSamsungAcFanHigh);
-      } else if (FAN_WARM == modeConst) {
-        acir.setMode(kSamsungAcHeat);
-        acir.setFan(kSamsungAcFanHigh);
-      }
-    } else {
-      acir.setFan(kSamsungAcFanHigh);
-      acir.setSwing(true);
+  if (applyClimateCommand(climateUnits[PRIMARY_AC].desired, json)) {
+    acFrameTrace = commandTrace;
+    climateUnits.schedule(PRIMARY_AC, AC_COALESCING_WINDOW);
+  }
+  return true;
+}
+
+// Power commands supersede a pending IRsendCmnd burst, the frame is transmitted right away.
+// The frame is forced, the AC may have been switched with its own remote.
+void sendAcPower(bool on) {
+  stdAc::state_t &state = climateUnits[PRIMARY_AC].desired;
+  state.power = on;
+  if (on) {
+    state.mode = stdAc::opmode_t::kCool;
+    state.degrees = 20;
+    state.fanspeed = stdAc::fanspeed_t::kLow;
+    state.swingv = stdAc::swingv_t::kOff;
+    state.quiet = false;
+    state.turbo = false;
+  }
+  {
+    CpuTransmitScope transmit(cpuGovernor);
+    climateUnits.send(PRIMARY_AC, true);
+  }
+  acDuty.set(climateUnits[PRIMARY_AC].sent.power, millis());
+}
+
+// {"name": "bedroom", "protocol": "DAIKIN", "model": 1} adds or updates a unit, {"name": "bedroom", "remove": true} removes it
+bool processClimateUnitsCmnd(JsonDocument json) {
+  const char *name = json["name"] | "";
+  bool changed;
+  if (json["remove"] | false) {
+    // the primary AC can't be removed, only its protocol can be changed
+    changed = strcmp(name, PRIMARY_AC_UNIT) != 0 && climateUnits.remove(name);
+  } else {
+    decode_type_t protocol = strToDecodeType(json["protocol"] | "");
+    changed = climateUnits.add(name, protocol, json["model"] | -1) >= 0;
+  }
+  if (changed) {
+    writeClimateUnits();
+  }
+  sendClimateUnitsState();
+  return changed;
+}
+
+// Unit addressed by the second level of cmnd/smartostatac/<unit>/...
+int8_t findTopicUnit() {
+  char name[ClimateUnit::NAME_SIZE];
+  const char *start = strchr(inboundTopic, '/');
+  start = (start != nullptr) ? strchr(start + 1, '/') : nullptr;
+  if (start == nullptr) return -1;
+  start++;
+  const char *end = strchr(start, '/');
+  size_t length = (end != nullptr) ? end - start : strlen(start);
+  if (length >= sizeof(name)) return -1;
+  memcpy(name, start, length);
+  name[length] = '\0';
+  int8_t index = climateUnits.find(name);
+  // the primary AC is driven by the cmnd/smartostatac topics
+  return (index == PRIMARY_AC) ? -1 : index;
+}
+
+bool processUnitOnOffCmnd(JsonDocument json) {
+  int8_t index = findTopicUnit();
+  if (index < 0) return false;
+  climateUnits[index].desired.power = (helper.isOnOff(json) == ON_CMD);
+  climateUnits.schedule(index, 0, true);
+  return true;
+}
+
+bool processUnitSendCmnd(JsonDocument json) {
+  int8_t index = findTopicUnit();
+  if (index < 0) return false;
+  if (!applyClimateCommand(climateUnits[index].desired, json)) return false;
+  climateUnits.schedule(index, AC_COALESCING_WINDOW);
+  return true;
+}
+
+// Same payload of cmnd/smartostatac/IRsendCmnd, false and state untouched if it isn't a climate command.
+// The previous temperature is kept if temp is missing.
+bool applyClimateCommand(stdAc::state_t &state, JsonDocument &json) {
+  if (!json["alette_ac"].is<JsonVariant>()) return false;
+  state.power = true;
+  state.mode = stdAc::opmode_t::kCool;
+  if (json["temp"].is<const char *>()) {
+    state.degrees = atof(json["temp"].as<const char *>());
+  } else if (json["temp"].is<float>()) {
+    state.degrees = json["temp"].as<float>();
+  }
+  state.quiet = false;
+  state.turbo = false;
+  String alette = json["alette_ac"];
+  if (alette == off_CMD) {
+    state.swingv = stdAc::swingv_t::kOff;
+    String modeConst = json["mode"];
+    if (FAN_LOW == modeConst) {
+      state.fanspeed = stdAc::fanspeed_t::kLow;
+    } else if (FAN_POWER == modeConst) {
+      state.turbo = true;
+    } else if (FAN_QUIET == modeConst) {
+      state.quiet = true;
+    } else if (FAN_AUTO == modeConst) {
+      state.fanspeed = stdAc::fanspeed_t::kAuto;
+    } else if (FAN_HIGH == modeConst) {
+      state.fanspeed = stdAc::fanspeed_t::kHigh;
+    } else if (FAN_WARM == modeConst) {
+      state.mode = stdAc::opmode_t::kHeat;
+      state.fanspeed = stdAc::fanspeed_t::kHigh;
     }
-    acir.send(IR_RETRY);
-    //Serial.printf("  %s\n", acir.toString().c_str());
+  } else {
+    state.fanspeed = stdAc::fanspeed_t::kHigh;
+    state.swingv = stdAc::swingv_t::kAuto;
   }
   return true;
 }
+
+void readClimateUnits() {
+  // added first so it's always PRIMARY_AC, a stored unit with the same name changes its protocol
+  climateUnits.add(PRIMARY_AC_UNIT, PRIMARY_AC_PROTOCOL, -1);
+  JsonDocument doc = bootstrapManager.readLittleFS(CLIMATE_UNITS_FILE);
+  if (doc[VALUE].is<JsonVariant>() && doc[VALUE] == ERROR) return;
+  for (JsonObject unit : doc["units"].as<JsonArray>()) {
+    climateUnits.add(unit["name"] | "", strToDecodeType(unit["protocol"] | ""), unit["model"] | -1);
+  }
+}
+
+void writeClimateUnits() {
+  JsonDocument doc;
+  JsonArray units = doc["units"].to<JsonArray>();
+  for (uint8_t i = 0; i < climateUnits.size(); i++) {
+    JsonObject unit = units.add<JsonObject>();
+    unit["name"] = climateUnits[i].name;
+    unit["protocol"] = typeToString(climateUnits[i].desired.protocol);
+    unit["model"] = climateUnits[i].desired.model;
+  }
+  bootstrapManager.writeToLittleFS(doc, CLIMATE_UNITS_FILE);
+}
+
+void sendClimateUnitsState() {
+  JsonObject root = bootstrapManager.getJsonObject();
+  JsonArray units = root["units"].to<JsonArray>();
+  for (uint8_t i = 0; i < climateUnits.size(); i++) {
+    JsonObject unit = units.add<JsonObject>();
+    unit["name"] = climateUnits[i].name;
+    unit["protocol"] = typeToString(climateUnits[i].desired.protocol);
+    unit["model"] = climateUnits[i].desired.model;
+    unit["state"] = climateUnits[i].desired.power ? ON_CMD : OFF_CMD;
+  }
+  publishMqtt(SMARTOSTATAC_STAT_UNITS, root, true);
+}
+
+void sendUnitACState(uint8_t index) {
+  String topic = "stat/smartostatac/";
+  topic += climateUnits[index].name;
+  topic += "/IRsend";
+  publishMqtt(topic.c_str(), climateUnits[index].sent.power ? ON_CMD.c_str() : OFF_CMD.c_str(), true);
+}
+
+// Transmit the frames of the climate units, acknowledged once they are on the air
+void manageClimateUnits() {
+  if (!climateUnits.due()) return;
+  int8_t index;
+  {
+    CpuTransmitScope transmit(cpuGovernor);
+    index = climateUnits.update();
+  }
+  if (index < 0) return;
+  if (index == PRIMARY_AC) {
+    // end of an IRsendCmnd burst
+    commandTrace = acFrameTrace;
+    acDuty.set(climateUnits[PRIMARY_AC].sent.power, millis());
+    markActuated();
+    sendCommandLatency(SMARTOSTATAC_CMND_IRSEND);
+  } else {
+    sendUnitACState(index);
+  }
+}
 #endif
 
 #if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
@@ -1115,7 +1440,7 @@ bool processSmartoledRebootCmnd(JsonDocument json) {
 
 bool processSmartostatFurnanceState(JsonDocument json) {
   furnance = helper.isOnOff(json);
-  return true;
+  return processRoomFurnanceState(json);
 }
 
 bool processACState(JsonDocument json) {
@@ -1123,6 +1448,209 @@ bool processACState(JsonDocument json) {
   return true;
 }
 
+// SENSOR state of the other smartostats
+bool processRoomSensorJson(JsonDocument json) {
+  SensorState sensor;
+  decodeJson(json.as<JsonObjectConst>(), sensor);
+  if (sensor.bme680.present) {
+    updateRoomSensor(sensor.bme680.temperature, sensor.bme680.humidity);
+  } else if (sensor.scd4x.present) {
+    updateRoomSensor(sensor.scd4x.temperature, sensor.scd4x.humidity);
+  }
+  return true;
+}
+
+bool processRoomFurnanceState(JsonDocument json) {
+  Room *room = rooms.findTopic(inboundTopic);
+  if (room == nullptr) return false;
+  room->furnanceOn = helper.isOnOff(json) == ON_CMD;
+  return true;
+}
+
+void updateRoomSensor(float roomTemperature, float roomHumidity) {
+  Room *room = rooms.findTopic(inboundTopic);
+  if (room == nullptr) return;
+  room->temperature = roomTemperature;
+  room->humidity = roomHumidity;
+  room->updatedAt = millis();
+}
+
+// The local smartostat first, then SMARTOLED_ROOMS. Their topics are built once here.
+void setupRooms() {
+  rooms.add(PRIMARY_ROOM, strlen(PRIMARY_ROOM));
+  rooms.addList(SMARTOLED_ROOMS);
+  for (uint8_t i = 1; i < rooms.size(); i++) {
+    snprintf(roomTopics[i * 2], sizeof(roomTopics[0]), "tele/%s/SENSOR", rooms[i].name);
+    snprintf(roomTopics[i * 2 + 1], sizeof(roomTopics[0]), "stat/%s/POWER1", rooms[i].name);
+  }
+}
+
+// Append the topics of the remote rooms, the local smartostat topics are subscribed with the others
+uint8_t addRoomSubscriptions(const char **topics) {
+  uint8_t count = 0;
+  for (uint8_t i = 2; i < rooms.size() * 2; i++) {
+    topics[count++] = roomTopics[i];
+  }
+  return count;
+}
+
+// One line per room: name, temperature, humidity and a flame while the furnance is on
+void drawRoomsPage() {
+  display.setTextSize(1);
+  display.setCursor(0, 0);
+  display.print(F("ROOMS"));
+  display.drawLine(0, 9, display.width(), 9, WHITE);
+  for (uint8_t i = 0; i < rooms.size(); i++) {
+    Room &room = rooms[i];
+    int16_t y = 12 + i * 10;
+    // smartostat_bedroom is shown as bedroom
+    const char *label = room.name;
+    if (strncmp(label, PRIMARY_ROOM, strlen(PRIMARY_ROOM)) == 0 && label[strlen(PRIMARY_ROOM)] == '_') {
+      label += strlen(PRIMARY_ROOM) + 1;
+    }
+    char name[10];
+    strlcpy(name, label, sizeof(name));
+    display.setCursor(0, y);
+    display.print(name);
+    display.setCursor(60, y);
+    if (room.updatedAt == 0 || millis() - room.updatedAt > ROOM_TIMEOUT) {
+      display.print(F("--"));
+      continue;
+    }
+    display.print(room.temperature, 1);
+    display.print(F("C"));
+    display.setCursor(96, y);
+    display.print(room.humidity, 0);
+    display.print(F("%"));
+    if (room.furnanceOn) {
+      display.fillTriangle(122, y + 7, 127, y + 7, 124, y, WHITE);
+    }
+  }
+}
+
+uint8_t roomsCount() {
+  return rooms.size();
+}
+
+bool processSpotifyStateJson(JsonDocument json) {
+  //serializeJsonPretty(json, Serial); Serial.println();
+  if (json["media_artist"].is<JsonVariant>()) {
+    spotifyActivity = helper.getValue(json["spotify_activity"]);
+    mediaTitle = helper.getValue(json["media_title"]);
+    spotifySource = helper.getValue(json["spotifySource"]);
+    volumeLevel = helper.getValue(json["volume_level"]);
+    mediaArtist = helper.getValue(json["media_artist"]);
+    appName = helper.getValue(json["app_name"]);
+    spotifyPosition = helper.getValue(json["position"]);
+
+    if (appName != BT_AUDIO) {
+      if ((spotifyActivity == SPOTIFY_PAUSED || spotifyActivity == SPOTIFY_IDLE) && mediaTitle == mediaTitlePrevious) {
+        cleanSpotifyInfo();
+      }
+      if ((mediaTitle != mediaTitlePrevious) && (mediaTitlePrevious != OFF_CMD) && (mediaTitle != BT_AUDIO)) {
+        currentPage = 8;
+      }
+    } else if (spotifyPosition != spotifyPositionPrevious) {
+      spotifyActivity = SPOTIFY_PLAYING;
+      if (mediaTitle != mediaTitlePrevious && (mediaTitle != BT_AUDIO)) {
+        currentPage = 8;
+      }
+    } else {
+      spotifyActivity = SPOTIFY_IDLE;
+      cleanSpotifyInfo();
+    }
+
+    if (mediaTitle.length() > 0) {
+      mediaClock.sync(helper.getValue(json["media_position"]).toFloat(),
+                      helper.getValue(json["media_duration"]).toFloat(), spotifyActivity == SPOTIFY_PLAYING, inboundReceivedAt);
+    }
+    mediaTitlePrevious = helper.getValue(json["media_title"]);
+    spotifyPositionPrevious = helper.getValue(json["position"]);
+  }
+  return true;
+}
+
+void cleanSpotifyInfo() {
+  mediaTitle = EMPTY_STR;
+  mediaArtist = EMPTY_STR;
+  spotifySource = EMPTY_STR;
+  volumeLevel = EMPTY_STR;
+  mediaClock.clear();
+  appName = EMPTY_STR;
+}
+
+bool mediaPlaying() {
+  return spotifyActivity == SPOTIFY_PLAYING;
+}
+
+// Page 8, the media playing on Spotify or on the Bluetooth audio
+void drawMediaPage() {
+  display.clearDisplay();
+  // display.fillTriangle(2, 8, 7, 3, 12, 8, WHITE);
+  display.fillTriangle(0, 0, 4, 4, 0, 8, WHITE);
+  if (appName == BT_AUDIO) {
+    display.drawBitmap((display.width() / 2) - (youtubeLogoW / 2), 0, youtubeLogo, youtubeLogoW, youtubeLogoH, 1);
+  } else {
+    display.drawBitmap((display.width() / 2) - (spotifyLogoW / 2), 0, spotifyLogo, spotifyLogoW, spotifyLogoH, 1);
+  }
+  display.setTextSize(2);
+  display.setTextWrap(false);
+
+  // 12 is the text width
+  int titleLen = mediaTitle.length() * 12;
+  if (-titleLen > offset) {
+    offset = 160;
+  } else {
+    offset -= 2;
+  }
+  display.setCursor(offset,spotifyLogoW + 5);
+
+  display.println(mediaTitle);
+
+  // 6 is the text width
+  int authorLen = mediaArtist.length() * 6;
+  if (authorLen > 128) {
+    if (-authorLen > offsetAuthor) {
+      offsetAuthor = 130;
+    } else {
+      offsetAuthor -= 1;
+    }
+  } else {
+    offsetAuthor = 0;
+  }
+  display.setTextSize(1);
+  display.setCursor(offsetAuthor, 47);
+  display.println(mediaArtist);
+
+  // float roundedVolumeLevel = volumeLevel.toFloat();
+  // int volume = (roundedVolumeLevel > 0.99) ? display.width() : ((roundedVolumeLevel*100)*1.28);
+  // draw position bar
+  int position = 0;
+  if (mediaClock.duration() > 0.01f) {
+    position = ((mediaClock.position() * 100.0f) / mediaClock.duration()) * 1.28f;
+  }
+  display.drawRect(0, (display.height() - 4), display.width(), 4, WHITE);
+  display.fillRect(0, (display.height() - 4), position, 4, WHITE);
+}
+
+#else
+
+// Only the Smartoled shows the rooms and the media
+uint8_t roomsCount() {
+  return 1;
+}
+
+bool mediaPlaying() {
+  return false;
+}
+
+void drawMediaPage() {
+}
+
+uint8_t addRoomSubscriptions(const char **topics) {
+  return 0;
+}
+
 #endif
 
 bool processSmartoledFramerate(JsonDocument json) {
@@ -1157,18 +1685,182 @@ void resetMinMaxValues() {
   maxGasResistance = 0.0;
   minIAQ = 2000;
   maxIAQ = 0.0;
+  SensorStatistics<float> *allStats[] = {&temperatureStats, &humidityStats, &pressureStats, &gasResistanceStats, &IAQStats};
+  for (SensorStatistics<float> *stats : allStats) {
+    stats->clear();
+  }
+}
+
+// Seconds since boot, millis() wraps every 49 days
+uint32_t uptimeSeconds() {
+  static unsigned long lastMillis = 0;
+  static unsigned long pendingMillis = 0;
+  static uint32_t seconds = 0;
+  unsigned long now = millis();
+  pendingMillis += now - lastMillis;
+  lastMillis = now;
+  seconds += pendingMillis / 1000;
+  pendingMillis %= 1000;
+  return seconds;
+}
+
+void addSensorStatistics(float temperatureSample, float humiditySample, float pressureSample,
+                         float gasResistanceSample, float IAQSample) {
+  uint32_t now = uptimeSeconds();
+  temperatureStats.add(temperatureSample, now);
+  humidityStats.add(humiditySample, now);
+  pressureStats.add(pressureSample, now);
+  gasResistanceStats.add(gasResistanceSample, now);
+  IAQStats.add(IAQSample, now);
+}
+
+// Min/max of the last 24 hours, values since the last reset until the first sample is received.
+// The window is advanced first, the smartoled samples only when its smartostat publishes.
+float dailyMin(SensorStatistics<float> &stats) {
+  stats.advance(uptimeSeconds());
+  return stats.day.empty() ? stats.minSinceReset : stats.day.min().value;
+}
+
+float dailyMax(SensorStatistics<float> &stats) {
+  stats.advance(uptimeSeconds());
+  return stats.day.empty() ? stats.maxSinceReset : stats.day.max().value;
 }
 
 /********************************** SEND STATE *****************************************/
 void sendPowerState() {
-  BootstrapManager::publish(SMARTOLED_STATE_TOPIC, (stateOn) ? ON_CMD.c_str() : OFF_CMD.c_str(),
+  publishMqtt(SMARTOLED_STATE_TOPIC, (stateOn) ? ON_CMD.c_str() : OFF_CMD.c_str(),
                            true);
 }
 
 void sendInfoState() {
   JsonObject root = bootstrapManager.getJsonObject();
   root["State"] = (stateOn) ? ON_CMD : OFF_CMD;
+  root["inboundDuplicates"] = inboundDuplicates;
+#if defined(ESP8266)
+  JsonObject gateway = root["gateway"].to<JsonObject>();
+  gateway["rtt"] = gatewayProbe.lastRtt;
+  gateway["rttMin"] = gatewayProbe.minRtt;
+  gateway["rttAvg"] = gatewayProbe.avgRtt;
+  gateway["rttMax"] = gatewayProbe.maxRtt;
+  gateway["sent"] = gatewayProbe.sent;
+  gateway["loss"] = gatewayProbe.lossPercentage();
+#endif
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+  root["gasOutliers"] = gasFilter.outliers;
+  root["IAQOutliers"] = IAQFilter.outliers;
+  root["acFramesCoalesced"] = climateUnits.framesCoalesced;
+  root["acFramesSkipped"] = climateUnits.framesSkipped;
+#endif
+  JsonObject cpu = root["cpu"].to<JsonObject>();
+  cpu["mhz"] = cpuGovernor.mhz();
+  cpu["switches"] = cpuGovernor.switches;
+  // seconds spent at each level and its frequency
+  for (uint8_t i = 0; i < CPU_LEVELS; i++) {
+    CpuLevel level = static_cast<CpuLevel>(i);
+    JsonObject residency = cpu[CpuGovernor::levelName(level)].to<JsonObject>();
+    residency["mhz"] = CpuGovernor::levelMhz(level);
+    residency["seconds"] = cpuGovernor.residency(level) / 1000;
+  }
   BootstrapManager::sendState(SMARTOLED_INFO_TOPIC, root, VERSION);
+  deviceMetrics.mqttPublished++;
+  serialTrace.mqtt(TRACE_MQTT_OUT, SMARTOLED_INFO_TOPIC, 0);
+  // the smartoled has no sensor, its first valid publish is the INFO state
+  if (!Target::HAS_CLIMATE_CONTROL && !bootProfiler.published) {
+    sendBootProfile();
+  }
+}
+
+void publishMqtt(const char *topic, const char *payload, boolean retained) {
+  BootstrapManager::publish(topic, payload, retained);
+  deviceMetrics.mqttPublished++;
+  serialTrace.mqtt(TRACE_MQTT_OUT, topic, strlen(payload));
+}
+
+void publishMqtt(const char *topic, JsonObject payload, boolean retained) {
+  if (serialTrace.enabled) serialTrace.mqtt(TRACE_MQTT_OUT, topic, measureJson(payload));
+  BootstrapManager::publish(topic, payload, retained);
+  deviceMetrics.mqttPublished++;
+}
+
+#if METRICS_ENABLED
+// GET /metrics, only formats the counters
+// The page is streamed with chunked transfer encoding, only a chunk is held in RAM
+void handleMetrics() {
+  char chunk[512];
+  metricsServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  metricsServer.send(200, "text/plain; version=0.0.4", EMPTY_STR);
+  MetricsPage metrics(chunk, sizeof(chunk), METRICS_PREFIX, sendMetricsChunk);
+  metrics.gauge("uptime_seconds", "Seconds since boot", uptimeSeconds());
+  metrics.counter("loop_iterations_total", "Main loop iterations", deviceMetrics.loops);
+  metrics.gauge("loop_iterations_per_second", "Main loop iterations in the last second", deviceMetrics.loopsPerSecond);
+  metrics.gauge("heap_free_bytes", "Free heap", ESP.getFreeHeap());
+#if defined(ESP8266)
+  metrics.gauge("heap_largest_free_block_bytes", "Largest allocatable heap block", ESP.getMaxFreeBlockSize());
+#else
+  metrics.gauge("heap_largest_free_block_bytes", "Largest allocatable heap block", ESP.getMaxAllocHeap());
+#endif
+  // the display commands and frames share the bus with the sensors
+  uint32_t i2cTransactions = deviceMetrics.i2cTransactions + displayController.commandsSent + displayController.framesSent;
+  uint32_t i2cErrors = deviceMetrics.i2cErrors;
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+  for (SensorDriver *driver : sensorDrivers) {
+    i2cTransactions += driver->transactions;
+    i2cErrors += driver->errors;
+  }
+#endif
+  metrics.counter("i2c_transactions_total", "I2C transactions, sensor reads and display commands and frames", i2cTransactions);
+  metrics.counter("i2c_errors_total", "Failed I2C transactions", i2cErrors);
+  metrics.gauge("cpu_frequency_mhz", "Current CPU frequency", cpuGovernor.mhz());
+  metrics.counter("cpu_frequency_switches_total", "CPU frequency changes", cpuGovernor.switches);
+  metrics.counter("cpu_idle_seconds_total", "Seconds at the idle CPU frequency", cpuGovernor.residency(CPU_IDLE) / 1000);
+  metrics.counter("cpu_timing_seconds_total", "Seconds at the IR timing CPU frequency", cpuGovernor.residency(CPU_TIMING) / 1000);
+  metrics.counter("cpu_boost_seconds_total", "Seconds at the boost CPU frequency", cpuGovernor.residency(CPU_BOOST) / 1000);
+  metrics.counter("mqtt_messages_received_total", "MQTT messages received", deviceMetrics.mqttReceived);
+  metrics.counter("mqtt_messages_published_total", "MQTT messages published", deviceMetrics.mqttPublished);
+  metrics.counter("mqtt_messages_dropped_total", "MQTT messages dropped by the full inbound queue", inboundDropped);
+  metrics.counter("mqtt_commands_rejected_total", "MQTT commands rejected by the full actuator queue", inboundRejected);
+  metrics.counter("mqtt_messages_oversized_total", "MQTT messages larger than MQTT_MAX_PACKET_SIZE", inboundOversized);
+  metrics.counter("mqtt_messages_duplicate_total", "Retained MQTT messages dropped as unchanged", inboundDuplicates);
+  metrics.counter("mqtt_reconnects_total", "MQTT reconnections after the first connection",
+                  deviceMetrics.mqttConnections > 0 ? deviceMetrics.mqttConnections - 1 : 0);
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+  metrics.counter("relay_cycles_total", "Furnance relay switched on", deviceMetrics.relayCycles);
+  metrics.counter("ir_frames_sent_total", "IR frames sent to the climate units", climateUnits.framesSent);
+  metrics.summary("sensor_read_duration_milliseconds", "BME680 forced mode measurement duration",
+                  deviceMetrics.sensorReadMsSum, deviceMetrics.sensorReads);
+  metrics.gauge("sensor_read_duration_max_milliseconds", "Longest BME680 measurement", deviceMetrics.sensorReadMsMax);
+#endif
+  metrics.finish();
+  // the empty chunk ends the response
+  metricsServer.sendContent(EMPTY_STR);
+}
+
+void sendMetricsChunk(const char *text, size_t length) {
+  metricsServer.sendContent(text, length);
+}
+#endif
+
+// Boot phases in ms since power on, published once after the first valid publish.
+// In offline mode there is no broker, the profile is printed on the serial port at the end of setup().
+void sendBootProfile() {
+  bootProfiler.mark(offlineMode ? "setup" : "firstPublish");
+  JsonObject root = bootstrapManager.getJsonObject();
+#if defined(ESP8266)
+  root["resetReason"] = ESP.getResetReason();
+#else
+  root["resetReason"] = static_cast<int>(esp_reset_reason());
+#endif
+  JsonObject phases = root["phases"].to<JsonObject>();
+  for (uint8_t i = 0; i < bootProfiler.size(); i++) {
+    phases[bootProfiler.name(i)] = bootProfiler.endedAt(i);
+  }
+  if (offlineMode) {
+    serializeJson(root, Serial);
+    Serial.println();
+  } else {
+    publishMqtt(BOOT_PROFILE_TOPIC, root, true);
+  }
+  bootProfiler.published = true;
 }
 
 inline float round1(float v) {
@@ -1179,7 +1871,7 @@ inline float round1(float v) {
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
 
 void sendSmartostatRebootState(String onOff) {
-  BootstrapManager::publish(SMARTOSTAT_STAT_REBOOT, onOff.c_str(), true);
+  publishMqtt(SMARTOSTAT_STAT_REBOOT, onOff.c_str(), true);
 }
 
 void sendSmartostatRebootCmnd() {
@@ -1188,29 +1880,66 @@ void sendSmartostatRebootCmnd() {
 }
 
 void sendPirState() {
-  BootstrapManager::publish(SMARTOSTAT_PIR_STATE_TOPIC,
+  publishMqtt(SMARTOSTAT_PIR_STATE_TOPIC,
                            (pir == ON_CMD) ? ON_CMD.c_str() : OFF_CMD.c_str(), true);
 }
 
-void sendSensorState() {
-  JsonObject root = bootstrapManager.getJsonObject();
-
-  root["Time"] = timedate;
-  root["state"] = (stateOn) ? ON_CMD : OFF_CMD;
-  root["POWER1"] = furnance;
-  root["POWER2"] = pir;
-
-  JsonObject BME680 = root["BME680"].to<JsonObject>();
-  if (readOnceEveryNTimess == 1 && sensorOk) {
-    yield();
-    if (!boschBME680.performReading()) {
-      Serial.println("Failed to perform reading :(");
-      delay(500);
-      return;
+// Read the sensors without blocking: start a measurement on every sensor and collect each one once it's ready
+void sampleSensors() {
+  bool startDue = millis() - lastSensorSample >= SENSOR_SAMPLING_PERIOD;
+  if (startDue) lastSensorSample = millis();
+  for (SensorDriver *driver : sensorDrivers) {
+    if (!driver->present) continue;
+    if (!driver->pending) {
+      // don't start a BME680 measurement while the gas reference is being read
+      if (!startDue || (driver == &bme680Driver && readGas)) continue;
+      if (!driver->start()) {
+        Serial.print(F("Failed to begin reading "));
+        Serial.println(driver->name());
+        continue;
+      }
+      driver->startedAt = millis();
+      driver->pending = true;
+      continue;
+    }
+    if (!driver->poll()) continue;
+    driver->pending = false;
+    SensorReading reading;
+    if (!driver->collect(reading)) {
+      Serial.print(F("Failed to perform reading "));
+      Serial.println(driver->name());
+      continue;
     }
-    temperature = round1(boschBME680.temperature + tempSensorOffset);
-    humidity = round1(boschBME680.humidity);
-    pressure = boschBME680.pressure / 100;
+    deviceMetrics.sensorRead(millis() - driver->startedAt);
+    if (reading.has(SENSOR_CO2)) {
+      serialTrace.co2(reading.co2, reading.temperature, reading.humidity);
+    } else {
+      serialTrace.sensor(reading.temperature, reading.humidity, reading.pressure, reading.gasResistance);
+    }
+    applySensorReading(*driver, reading);
+  }
+}
+
+// Update the channels owned by the driver, the others are only published under the sensor name
+void applySensorReading(const SensorDriver &driver, const SensorReading &reading) {
+  uint32_t now = uptimeSeconds();
+  if (driver.owned & SENSOR_TEMPERATURE) {
+    temperature = round1(reading.temperature + tempSensorOffset);
+    furnanceDuty.integrate(isnan(heatingTarget) ? 0 : heatingTarget - temperature, millis());
+    temperatureStats.add(temperature, now);
+    sensorInterval.temperature.add(temperature, now);
+  }
+  if (driver.owned & SENSOR_HUMIDITY) {
+    humidity = round1(reading.humidity);
+    humidityStats.add(humidity, now);
+    sensorInterval.humidity.add(humidity, now);
+  }
+  if (driver.owned & SENSOR_PRESSURE) {
+    pressure = reading.pressure / 100;
+    pressureStats.add(pressure, now);
+    sensorInterval.pressure.add(pressure, now);
+  }
+  if ((driver.owned & SENSOR_GAS_RESISTANCE) && reading.has(SENSOR_GAS_RESISTANCE)) {
     humidity_score = getHumidityScore();
     if ((getgasreference_count++) % 5 == 0) {
       readGas = true;
@@ -1219,44 +1948,178 @@ void sendSensorState() {
     gas_score = getGasScore();
     //Combine results for the final IAQ index value (0-100% where 100% is good quality air)
     float air_quality_score = humidity_score + gas_score;
-    IAQ = round1(calculateIAQ(air_quality_score));
-    minTemperature = (temperature < minTemperature) ? temperature : minTemperature;
-    maxTemperature = (temperature > maxTemperature) ? temperature : maxTemperature;
-    minHumidity = (humidity < minHumidity) ? humidity : minHumidity;
-    maxHumidity = (humidity > maxHumidity) ? humidity : maxHumidity;
-    minPressure = (pressure < minPressure) ? pressure : minPressure;
-    maxPressure = (pressure > maxPressure) ? pressure : maxPressure;
-    minGasResistance = (gasResistance < minGasResistance) ? gasResistance : minGasResistance;
-    maxGasResistance = (gasResistance > maxGasResistance) ? gasResistance : maxGasResistance;
-    minIAQ = (IAQ < minIAQ) ? IAQ : minIAQ;
-    maxIAQ = (IAQ > maxIAQ) ? IAQ : maxIAQ;
-  }
-  BME680["Temperature"] = temperature;
-  BME680["Humidity"] = humidity;
-  BME680["Pressure"] = pressure;
-  BME680["GasResistance"] = gasResistance;
-  BME680["IAQ"] = IAQ;
-  readOnceEveryNTimess++;
-  // BME680 is in forced mode, it sleeps until it read to avoid self heating
-  if (readOnceEveryNTimess == 5) {
-    readOnceEveryNTimess = 0;
-  }
-  if (temperature != 0 && humidity != 0 && pressure != 0 && gasResistance != 0
-      && temperature != -100.0f && humidity != -100.0f && pressure != -100.0f && gasResistance != -100.0f) {
-    BootstrapManager::publish(SMARTOSTAT_SENSOR_STATE_TOPIC, root, true);
+    IAQ = round1(IAQFilter.filter(calculateIAQ(air_quality_score)));
+    gasResistanceStats.add(gasResistance, now);
+    IAQStats.add(IAQ, now);
+    sensorInterval.gasResistance.add(gasResistance, now);
+    sensorInterval.IAQ.add(IAQ, now);
+  }
+  if (reading.has(SENSOR_CO2)) {
+    co2 = reading.co2;
+    sensorInterval.co2.add(co2, now);
+    sensorInterval.scd4xTemperature.add(round1(reading.temperature + tempSensorOffset), now);
+    sensorInterval.scd4xHumidity.add(round1(reading.humidity), now);
+  }
+  // publish the first sample right away instead of waiting for the next status cycle
+  if ((driver.owned & SENSOR_TEMPERATURE) && !bootProfiler.published && !publishing) {
+    timeNowStatus = millis() - tenSecondsPeriod - 1;
+  }
+}
+
+void addSensorInterval(float &mean, float &min, float &max, const StatsBucket<float> &interval) {
+  mean = interval.moments.mean;
+  min = interval.min.value;
+  max = interval.max.value;
+}
+
+// Publish the aggregate of the samples read since the last publish, every 10 s.
+// The gas channels are sampled less often, they repeat their last aggregate until the next gas reading.
+void sendSensorState() {
+  static SensorInterval publishedInterval;
+  sensorInterval.moveTo(publishedInterval);
+
+  static char payload[512];
+  SensorState sensor;
+  strlcpy(sensor.time, timedate.c_str(), sizeof(sensor.time));
+  strlcpy(sensor.state, (stateOn) ? ON_CMD.c_str() : OFF_CMD.c_str(), sizeof(sensor.state));
+  strlcpy(sensor.power1, furnance.c_str(), sizeof(sensor.power1));
+  strlcpy(sensor.power2, pir.c_str(), sizeof(sensor.power2));
+  // every sensor is published under its own name with the channels it measures
+  if (bme680Driver.present && publishedInterval.gasResistance.moments.count > 0) {
+    SensorBME680 &BME680 = sensor.bme680;
+    BME680.present = true;
+    addSensorInterval(BME680.temperature, BME680.min.temperature, BME680.max.temperature, publishedInterval.temperature);
+    addSensorInterval(BME680.humidity, BME680.min.humidity, BME680.max.humidity, publishedInterval.humidity);
+    addSensorInterval(BME680.pressure, BME680.min.pressure, BME680.max.pressure, publishedInterval.pressure);
+    addSensorInterval(BME680.gasResistance, BME680.min.gasResistance, BME680.max.gasResistance, publishedInterval.gasResistance);
+    addSensorInterval(BME680.iaq, BME680.min.iaq, BME680.max.iaq, publishedInterval.IAQ);
+    BME680.samples = publishedInterval.temperature.moments.count;
+  }
+  if (scd4xDriver.present && publishedInterval.co2.moments.count > 0) {
+    SensorSCD4x &SCD4x = sensor.scd4x;
+    SCD4x.present = true;
+    SCD4x.co2 = publishedInterval.co2.moments.mean;
+    SCD4x.temperature = publishedInterval.scd4xTemperature.moments.mean;
+    SCD4x.humidity = publishedInterval.scd4xHumidity.moments.mean;
+    SCD4x.samples = publishedInterval.co2.moments.count;
+  }
+  if ((sensor.bme680.present || sensor.scd4x.present)
+      && temperature != 0 && humidity != 0 && temperature != -100.0f && humidity != -100.0f
+      && encodeJson(sensor, payload, sizeof(payload)) > 0) {
+    publishMqtt(SMARTOSTAT_SENSOR_STATE_TOPIC, payload, true);
+    if (!bootProfiler.published) {
+      sendBootProfile();
+    }
+  }
+}
+
+// Last hour, 24 hours and 7 days statistics, one message per window so each one fits MQTT_MAX_PACKET_SIZE.
+// Ages are the seconds elapsed since the extreme has been read.
+void sendStatisticsState() {
+  uint32_t now = uptimeSeconds();
+  SensorStatistics<float> *allStats[] = {&temperatureStats, &humidityStats, &pressureStats, &gasResistanceStats, &IAQStats};
+  for (SensorStatistics<float> *stats : allStats) {
+    stats->advance(now);
+  }
+  for (uint8_t window = 0; window < 3; window++) {
+    JsonDocument doc;
+    JsonObject root = doc.to<JsonObject>();
+    root["window"] = (window == 0) ? "1h" : (window == 1) ? "24h" : "7d";
+    const char *names[] = {"Temperature", "Humidity", "Pressure", "GasResistance", "IAQ"};
+    for (uint8_t i = 0; i < 5; i++) {
+      if (window == 0) {
+        addWindowStatistics(root, names[i], allStats[i]->hour, now);
+      } else if (window == 1) {
+        addWindowStatistics(root, names[i], allStats[i]->day, now);
+      } else {
+        addWindowStatistics(root, names[i], allStats[i]->week, now);
+      }
+    }
+    publishMqtt(SMARTOSTAT_STATS_TOPIC, root, false);
+  }
+}
+
+template<uint8_t BUCKETS>
+void addWindowStatistics(JsonObject root, const char *name, const RollingWindow<float, BUCKETS> &window, uint32_t now) {
+  if (window.empty()) return;
+  Welford<float> moments = window.moments();
+  Extreme<float> windowMin = window.min();
+  Extreme<float> windowMax = window.max();
+  JsonObject channel = root[name].to<JsonObject>();
+  channel["min"] = windowMin.value;
+  channel["minAge"] = now - windowMin.timestamp;
+  channel["max"] = windowMax.value;
+  channel["maxAge"] = now - windowMax.timestamp;
+  channel["mean"] = roundf(moments.mean * 10.0f) / 10.0f;
+  channel["stddev"] = roundf(moments.stddev() * 100.0f) / 100.0f;
+}
+
+// Day of an ISO 8601 time (2026-10-19T08:30:00) as year * 372 + month * 31 + day, exact in a float
+float dayKey(const String &isoTime) {
+  if (isoTime.length() < 10) return 0;
+  return isoTime.substring(0, 4).toInt() * 372 + isoTime.substring(5, 7).toInt() * 31 + isoTime.substring(8, 10).toInt();
+}
+
+// Today's counters restart when Home Assistant's time moves to another day
+void checkAccountingDay() {
+  float today = dayKey(timedate);
+  if (today == 0 || today == accountingDay) return;
+  if (accountingDay != 0) {
+    furnanceDuty.newDay(millis());
+    acDuty.newDay(millis());
+  }
+  accountingDay = today;
+}
+
+void addDutyCycle(JsonObject root, const char *name, const DutyCycle &duty, bool degreeMinutes) {
+  JsonObject channel = root[name].to<JsonObject>();
+  JsonObject today = channel["today"].to<JsonObject>();
+  today["runtime"] = static_cast<uint32_t>(duty.runtimeToday);
+  today["cycles"] = static_cast<uint32_t>(duty.cyclesToday);
+  today["avgCycle"] = static_cast<uint32_t>(duty.averageCycle());
+  JsonObject hour = channel["lastHour"].to<JsonObject>();
+  hour["runtime"] = static_cast<uint32_t>(duty.hour().runtime);
+  hour["cycles"] = duty.hour().cycles;
+  if (degreeMinutes) {
+    today["degreeMinutes"] = round1(duty.degreeMinutesToday);
+    hour["degreeMinutes"] = round1(duty.hour().degreeMinutes);
   }
 }
 
+// Runtimes and average cycle in seconds
+void sendDutyCycleState() {
+  JsonObject root = bootstrapManager.getJsonObject();
+  addDutyCycle(root, "furnance", furnanceDuty, true);
+  addDutyCycle(root, "ac", acDuty, false);
+  publishMqtt(SMARTOSTAT_DUTY_TOPIC, root, true);
+}
+
 void sendFurnanceState() {
-  BootstrapManager::publish(SMARTOSTAT_FURNANCE_STATE_TOPIC,
+  publishMqtt(SMARTOSTAT_FURNANCE_STATE_TOPIC,
                            (furnance == OFF_CMD) ? OFF_CMD.c_str() : ON_CMD.c_str(), true);
 }
+
+// Published after the acknowledgement, the ack time is the time this message is built
+void sendCommandLatency(const char *command) {
+  unsigned long ackedAt = millis();
+  JsonObject root = bootstrapManager.getJsonObject();
+  root["command"] = command;
+  if (commandTrace.correlationId.length() > 0) {
+    root[CORRELATION_ID] = commandTrace.correlationId;
+  }
+  root["received"] = commandTrace.receivedAt;
+  root["actuated"] = commandTrace.actuatedAt;
+  root["acked"] = ackedAt;
+  root["toActuation"] = commandTrace.actuatedAt - commandTrace.receivedAt;
+  root["toAck"] = ackedAt - commandTrace.receivedAt;
+  publishMqtt(SMARTOSTAT_LATENCY_TOPIC, root, false);
+}
 #endif
 
 #if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
 
 void sendSmartoledRebootState(String onOff) {
-  BootstrapManager::publish(SMARTOLED_STAT_REBOOT, onOff.c_str(), true);
+  publishMqtt(SMARTOLED_STAT_REBOOT, onOff.c_str(), true);
 }
 
 void sendSmartoledRebootCmnd() {
@@ -1267,27 +2130,27 @@ void sendSmartoledRebootCmnd() {
 #endif
 
 void sendACCommandState() {
-  BootstrapManager::publish(SMARTOSTATAC_CMND_IRSENDSTATE,
+  publishMqtt(SMARTOSTATAC_CMND_IRSENDSTATE,
                            (ac == OFF_CMD) ? OFF_CMD.c_str() : ON_CMD.c_str(), true);
 }
 
 void sendClimateState(String mode) {
   if (mode == COOL) {
-    BootstrapManager::publish(SMARTOSTAT_CMND_CLIMATE_COOL_STATE,
+    publishMqtt(SMARTOSTAT_CMND_CLIMATE_COOL_STATE,
                              (ac == OFF_CMD) ? OFF_CMD.c_str() : ON_CMD.c_str(), true);
   } else {
-    BootstrapManager::publish(SMARTOSTAT_CMND_CLIMATE_HEAT_STATE,
+    publishMqtt(SMARTOSTAT_CMND_CLIMATE_HEAT_STATE,
                              (furnance == OFF_CMD) ? OFF_CMD.c_str() : ON_CMD.c_str(), true);
   }
 }
 
 void sendFurnanceCommandState() {
-  BootstrapManager::publish(SMARTOSTAT_FURNANCE_CMND_TOPIC,
+  publishMqtt(SMARTOSTAT_FURNANCE_CMND_TOPIC,
                            (furnance == OFF_CMD) ? OFF_CMD.c_str() : ON_CMD.c_str(), true);
 }
 
 void sendACState() {
-  BootstrapManager::publish(SMARTOSTATAC_STAT_IRSEND,
+  publishMqtt(SMARTOSTATAC_STAT_IRSEND,
                            (ac == OFF_CMD) ? OFF_CMD.c_str() : ON_CMD.c_str(), true);
 }
 
@@ -1318,11 +2181,7 @@ void delayAndSendStatus() {
   }
   publishStep.step++;
   lastPublishTime = millis();
-#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-  if (publishStep.step > 4) publishing = false;
-#else
-  if (publishStep.step > 1) publishing = false;
-#endif
+  if (publishStep.step > (Target::HAS_CLIMATE_CONTROL ? 4 : 1)) publishing = false;
 }
 
 
@@ -1345,16 +2204,24 @@ void delayAndSendStatus() {
 void goToHomePageAndWriteToStorageAfterFiveMinutes() {
   if (millis() > timeNowGoHomeAfterFiveMinutes + fiveMinutesPeriod) {
     timeNowGoHomeAfterFiveMinutes = millis();
-    // Ping gateway to add presence on the routing table,
-    // command is synchrounous and adds a bit of lag to the loop
+    // Ping gateway to add presence on the routing table, the reply is accounted by the main loop
 #if defined(ESP8266)
-    pingESP.ping();
+    gatewayProbe.send(WiFi.gatewayIP());
 #endif
-    // Write data to file system
+    sendIngestState();
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+    furnanceDuty.settle(millis());
+    acDuty.settle(millis());
+#endif
+    // Journal changed min/max values and today's accounting to the file system
     writeConfigToStorage();
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+    sendStatisticsState();
+    sendDutyCycleState();
+#endif
     screenSaverTriggered = true;
     if ((humidity != -100.f && humidity < humidityThreshold) && (loadFloatPrevious < HIGH_WATT) && (
-          (spotifyActivity == SPOTIFY_PLAYING && currentPage != 8) || spotifyActivity != SPOTIFY_PLAYING)) {
+          (mediaPlaying() && currentPage != 8) || !mediaPlaying())) {
       currentPage = 0;
     }
   }
@@ -1364,6 +2231,7 @@ void goToHomePageAndWriteToStorageAfterFiveMinutes() {
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
 
 void pirManagement() {
+  serialTrace.level(SR501_PIR_PIN, digitalRead(SR501_PIR_PIN));
   if (digitalRead(SR501_PIR_PIN) == HIGH) {
     if (pir == OFF_CMD) {
       highIn = millis();
@@ -1396,38 +2264,16 @@ void pirManagement() {
 
 void releManagement() {
   if (furnance == ON_CMD) {
+    if (!furnanceDuty.isRunning()) deviceMetrics.relayCycles++;
     digitalWrite(RELE_PIN, HIGH);
   } else {
     digitalWrite(RELE_PIN, LOW);
   }
+  furnanceDuty.set(furnance == ON_CMD, millis());
 }
 
 void acManagement() {
-  if (ac == ON_CMD) {
-    acir.on();
-    acir.setFan(kSamsungAcFanLow);
-    acir.setMode(kSamsungAcCool);
-    acir.setTemp(20);
-    acir.setSwing(false);
-    acir.sendExtended(IR_RETRY);
-  } else {
-    acir.off();
-    acir.sendOff(IR_RETRY);
-  }
-}
-
-void getGasReferenceBlocking() {
-  // Now run the sensor for a burn-in period, then use combination of relative humidity and gas resistance to estimate indoor air quality as a percentage.
-  //Serial.println("Getting a new gas reference value");
-  int readings = 10;
-  for (int i = 1; i <= readings; i++) {
-    yield();
-    // read gas for 10 x 0.150mS = 1.5secs
-    gas_reference += boschBME680.readGas();
-  }
-  gas_reference = gas_reference / readings;
-  //Serial.println("Gas Reference = "+String(gas_reference,3));
-  getgasreference_count = 0;
+  sendAcPower(ac == ON_CMD);
 }
 
 void getGasReference() {
@@ -1443,7 +2289,11 @@ void getGasReference() {
     readGas = false;
     return;
   }
-  gasSum += boschBME680.readGas();
+  bme680Driver.setGasHeater(true);
+  uint32_t gas = boschBME680.readGas();
+  deviceMetrics.i2cTransactions++;
+  if (gas == 0) deviceMetrics.i2cErrors++;
+  gasSum += gasFilter.filter(gas);
   samples++;
 }
 
@@ -1489,14 +2339,14 @@ void manageIrRecv() {
   if (irrecv.decode(&results)) {
     // Check if we got an IR message that was to big for our capture buffer.
     if (results.overflow) {
-      BootstrapManager::publish(IR_RECV_TOPIC, "MSG TOO BIG FOR THE BUFFER", false);
+      publishMqtt(IR_RECV_TOPIC, "MSG TOO BIG FOR THE BUFFER", false);
     }
     // Display the basic output of what we found.
-    BootstrapManager::publish(IR_RECV_TOPIC, Helpers::string2char(resultToHumanReadableBasic(&results)), false);
+    publishMqtt(IR_RECV_TOPIC, Helpers::string2char(resultToHumanReadableBasic(&results)), false);
     // Display any extra A/C info if we have it.
     String description = IRAcUtils::resultAcToString(&results);
     if (description.length()) {
-      BootstrapManager::publish(IR_RECV_TOPIC, Helpers::string2char(D_STR_MESGDESC ": " + description), false);
+      publishMqtt(IR_RECV_TOPIC, Helpers::string2char(D_STR_MESGDESC ": " + description), false);
     }
     yield(); // Feed the WDT as the text output can take a while to print.
     // Output the results as source code
@@ -1504,9 +2354,9 @@ void manageIrRecv() {
     int chunkSize = 900;
     for (unsigned i = 0; i < srcCode.length(); i += chunkSize) {
       if (i + chunkSize < srcCode.length()) {
-        BootstrapManager::publish(IR_RECV_TOPIC, Helpers::string2char(srcCode.substring(i, i + chunkSize)), false);
+        publishMqtt(IR_RECV_TOPIC, Helpers::string2char(srcCode.substring(i, i + chunkSize)), false);
       } else {
-        BootstrapManager::publish(IR_RECV_TOPIC, Helpers::string2char(srcCode.substring(i, srcCode.length())), false);
+        publishMqtt(IR_RECV_TOPIC, Helpers::string2char(srcCode.substring(i, srcCode.length())), false);
       }
       delay(DELAY_500);
     }
@@ -1519,6 +2369,7 @@ void manageIrRecv() {
 /********************************** TOUCH BUTTON MANAGEMENT *****************************************/
 void touchButtonManagement(int digitalReadButtonPin) {
   buttonState = digitalReadButtonPin;
+  serialTrace.level(lastButtonPressed, buttonState);
   // Quick presses
   if (buttonState == HIGH && lastReading == LOW) {
     // function triggered on the quick press of the button
@@ -1542,26 +2393,17 @@ void touchButtonManagement(int digitalReadButtonPin) {
   }
   // Long press for a second
   if (buttonState == HIGH && lastReading == HIGH) {
-#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-    if ((millis() - onTime) > 4000) {
-      // a second hold time
-      lastReading = LOW;
-      veryLongPress = true;
-    }
-#endif
-#if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
     if (((millis() - onTime) > 4000)) {
       // a second hold time
       lastReading = LOW;
       longPress = false;
       veryLongPress = true;
-    } else if (((millis() - onTime) > 1000)) {
-      // a second hold time
+    } else if (!Target::HAS_CLIMATE_CONTROL && ((millis() - onTime) > 1000)) {
+      // a second hold time, the smartostat button has no long press
       lastReading = LOW;
       longPress = true;
       veryLongPress = false;
     }
-#endif
   }
   lastReading = buttonState;
 }
@@ -1587,9 +2429,7 @@ void commandButtonRelease() {
     if (ac == ON_CMD) {
       ac = OFF_CMD;
     } else {
-#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-      acTriggered = true;
-#endif
+      if (Target::HAS_CLIMATE_CONTROL) acTriggered = true;
       ac = ON_CMD;
     }
     sendACCommandState();
@@ -1602,9 +2442,7 @@ void commandButtonRelease() {
     if (furnance == ON_CMD) {
       furnance = OFF_CMD;
     } else {
-#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-      furnanceTriggered = true;
-#endif
+      if (Target::HAS_CLIMATE_CONTROL) furnanceTriggered = true;
       furnance = ON_CMD;
     }
     sendFurnanceCommandState();
@@ -1619,9 +2457,7 @@ void commandButtonRelease() {
 void quickPressRelease() {
   // turn on the furnance
   if (lastButtonPressed == SMARTOSTAT_BUTTON_PIN) {
-#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-    commandButtonRelease();
-#endif
+    if (Target::HAS_CLIMATE_CONTROL) commandButtonRelease();
   } else {
     // go to the next page if display is on, skip next page if the display was off
     if (stateOn) {
@@ -1644,6 +2480,12 @@ void quickPressRelease() {
 
 /********************************** SPIFFS MANAGEMENT *****************************************/
 void readConfigFromStorage() {
+  statsJournal.attach(persistedStats, sizeof(persistedStats) / sizeof(persistedStats[0]));
+  if (statsJournal.restore()) {
+    Serial.println(F("\nReload previously stored values."));
+    return;
+  }
+  // First boot after the journal introduction, migrate the values from the legacy config file
   JsonDocument doc;
   doc = bootstrapManager.readLittleFS("config.json");
   if (!(doc[VALUE].is<JsonVariant>() && doc[VALUE] == ERROR)) {
@@ -1658,30 +2500,37 @@ void readConfigFromStorage() {
     maxGasResistance = doc["maxGasResistance"];
     minIAQ = doc["minIAQ"];
     maxIAQ = doc["maxIAQ"];
+    statsJournal.compact();
   }
 }
 
+// Append only the min/max values changed since the last write, nothing is written if nothing changed
 void writeConfigToStorage() {
-  JsonDocument doc;
-  doc["minTemperature"] = minTemperature;
-  doc["maxTemperature"] = maxTemperature;
-  doc["minHumidity"] = minHumidity;
-  doc["maxHumidity"] = maxHumidity;
-  doc["minPressure"] = minPressure;
-  doc["maxPressure"] = maxPressure;
-  doc["minGasResistance"] = minGasResistance;
-  doc["maxGasResistance"] = maxGasResistance;
-  doc["minIAQ"] = minIAQ;
-  doc["maxIAQ"] = maxIAQ;
-  bootstrapManager.writeToLittleFS(doc, "config.json");
+  statsJournal.flush();
 }
 
 /********************************** START MAIN LOOP *****************************************/
 void loop() {
+  deviceMetrics.loopTick();
+  serialTrace.loop();
+  cpuGovernor.update();
   if (!offlineMode) {
     // Bootsrap loop() with Wifi, MQTT and OTA functions
     bootstrapManager.bootstrapLoop(manageDisconnections, manageQueueSubscription, manageHardwareButton);
+    // Execute the MQTT messages received by the bootstrap loop
+    processInboundQueue();
+#if METRICS_ENABLED
+    metricsServer.handleClient();
+#endif
+#if defined(ESP8266)
+    gatewayProbe.update();
+#endif
+#if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
+    manageClimateUnits();
+#endif
 
+    // the smartoled only shows the IR logo, it doesn't capture
+    cpuGovernor.setCapturing(Target::HAS_CLIMATE_CONTROL && irReceiveActive);
     if (irReceiveActive) {
       if (!printIrReceiving) {
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
@@ -1689,6 +2538,7 @@ void loop() {
         irrecv.setUnknownThreshold(12);
         irrecv.enableIRIn(); // Start the receiver
 #endif
+        displayController.setPower(true);
         drawCenterScreenLogo(showHaSplashScreen, IR_RECV_LOGO, IR_RECV_LOGO_W, IR_RECV_LOGO_H, 0);
         printIrReceiving = true;
       }
@@ -1714,18 +2564,21 @@ void loop() {
       delayAndSendStatus();
 
       // DRAW THE SCREEN
-#if defined(TARGET_SMARTOLED) || defined(TARGET_SMARTOLED_ESP32)
-      if (stateOn || (loadFloat > HIGH_WATT)) {
-#elif defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-      if (stateOn) {
-#endif
+      if (stateOn || (Target::WAKES_ON_HIGH_LOAD && loadFloat > HIGH_WATT)) {
+        uint32_t framesSent = displayController.framesSent;
         draw();
+        // a new frame means new data, a page change or an animation, the next ones are rendered at full speed
+        if (displayController.framesSent != framesSent) cpuGovernor.boost();
+        displayController.setPower(true);
+      } else if (isCenterLogoActive()) {
+        displayController.setPower(true);
+        displayController.show();
       } else {
-        if (!isCenterLogoActive()) {
-          display.clearDisplay();
-        }
-        display.display();
+        // panel off instead of pushing a black frame on every loop
+        display.clearDisplay();
+        displayController.setPower(false);
       }
+      displayController.update();
 #if defined(ESP8266)
       ESP.wdtFeed();
 #endif
@@ -1738,9 +2591,10 @@ void loop() {
 #endif
       updateCenterScreenLogo();
 #if defined(TARGET_SMARTOSTAT) || defined(TARGET_SMARTOSTAT_ESP32)
-      if (readGas) getGasReference();
+      sampleSensors();
+      if (readGas && !bme680Driver.pending) getGasReference();
 #endif
-#if defined(TARGET_SMARTOSTAT_ESP32) || defined(TARGET_SMARTOLED_ESP32)
+#if defined(ARDUINO_ARCH_ESP32)
       if (millis() - lastMillisForWatchdog >= 500) {
         lastMillisForWatchdog = millis();
         esp_task_wdt_reset();
@@ -1749,6 +2603,7 @@ void loop() {
     }
   } else {
     // OFFLINE MODE
+    displayController.setPower(true);
     display.clearDisplay();
     display.setTextSize(1);
     display.setCursor(0, 0);
@@ -1792,7 +2647,7 @@ void loop() {
     }
 #endif
 
-    display.display();
+    displayController.show();
   }
 
 }
@@ -0,0 +1,190 @@
+"""
+  serial_trace.py - Decode the binary profiling frames streamed by SerialTrace.h into CSV or a Perfetto trace
+
+  Copyright © 2020 - 2026  Davide Perini
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  You should have received a copy of the MIT License along with this program.
+  If not, see <https://opensource.org/licenses/MIT/>.
+
+  Build with '-D SERIAL_TRACE_ENABLED=true', then capture and decode:
+    python tools/serial_trace.py --port COM3 --baud 921600 --csv trace.csv
+    python tools/serial_trace.py --input capture.bin --perfetto trace.json
+  The Perfetto output is the Chrome JSON trace format, open it with https://ui.perfetto.dev
+"""
+
+import argparse
+import csv
+import json
+import struct
+import sys
+
+SYNC = b"\xA5\x5A"
+HEADER = struct.Struct("<BBHI")
+TYPES = {1: "loop", 2: "sensor", 3: "edge", 4: "mqtt_in", 5: "mqtt_out", 6: "co2"}
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, the same as SerialTrace::crc16()"""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def decode_payload(kind, payload):
+    if kind == 1:
+        return {"duration_us": struct.unpack("<I", payload)[0]}
+    if kind == 2:
+        temperature, humidity, pressure, gas = struct.unpack("<fffI", payload)
+        return {"temperature": temperature, "humidity": humidity, "pressure": pressure, "gas_resistance": gas}
+    if kind == 3:
+        return {"pin": payload[0], "level": payload[1]}
+    if kind in (4, 5):
+        return {"length": struct.unpack("<H", payload[:2])[0], "topic": payload[2:].decode("utf-8", "replace")}
+    if kind == 6:
+        co2, temperature, humidity = struct.unpack("<fff", payload)
+        return {"co2": co2, "temperature": temperature, "humidity": humidity}
+    return {"raw": payload.hex()}
+
+
+class Decoder:
+    """Feed it bytes, it yields the valid frames and skips everything else"""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.last_sequence = None
+        self.time_high = 0
+        self.last_micros = None
+        self.crc_errors = 0
+        self.lost = 0
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                # keep the last byte, it may be the first sync byte
+                del self.buffer[:max(0, len(self.buffer) - 1)]
+                return
+            del self.buffer[:start]
+            if len(self.buffer) < 2 + HEADER.size:
+                return
+            kind, length, sequence, micros = HEADER.unpack_from(self.buffer, 2)
+            size = 2 + HEADER.size + length + 2
+            if len(self.buffer) < size:
+                return
+            body = bytes(self.buffer[2:size - 2])
+            crc = struct.unpack_from("<H", self.buffer, size - 2)[0]
+            if crc16(body) != crc:
+                # not a frame, or a corrupted one: resync from the next byte
+                self.crc_errors += 1
+                del self.buffer[:1]
+                continue
+            del self.buffer[:size]
+            yield self.frame(kind, sequence, micros, body[HEADER.size:])
+
+    def frame(self, kind, sequence, micros, payload):
+        if self.last_sequence is not None:
+            self.lost += (sequence - self.last_sequence - 1) & 0xFFFF
+        self.last_sequence = sequence
+        # micros() wraps every ~71 minutes
+        if self.last_micros is not None and micros < self.last_micros:
+            self.time_high += 1 << 32
+        self.last_micros = micros
+        frame = {"sequence": sequence, "time_us": self.time_high + micros, "type": TYPES.get(kind, str(kind))}
+        frame.update(decode_payload(kind, payload))
+        return frame
+
+
+def read_source(args):
+    if args.port:
+        import serial  # pyserial
+        port = serial.Serial(args.port, args.baud, timeout=0.1)
+        try:
+            while True:
+                yield port.read(4096)
+        except KeyboardInterrupt:
+            return
+    with open(args.input, "rb") as capture:
+        while True:
+            chunk = capture.read(65536)
+            if not chunk:
+                return
+            yield chunk
+
+
+def perfetto_events(frames):
+    """Loop iterations become slices ending at their frame, the rest instant events or counters"""
+    events = []
+    for frame in frames:
+        ts = frame["time_us"]
+        if frame["type"] == "loop":
+            events.append({"name": "loop", "ph": "X", "ts": ts - frame["duration_us"], "dur": frame["duration_us"],
+                           "pid": 1, "tid": 1})
+        elif frame["type"] == "sensor":
+            events.append({"name": "BME680", "ph": "C", "ts": ts, "pid": 1,
+                           "args": {"temperature": frame["temperature"], "humidity": frame["humidity"]}})
+            events.append({"name": "gas_resistance", "ph": "C", "ts": ts, "pid": 1,
+                           "args": {"ohm": frame["gas_resistance"]}})
+        elif frame["type"] == "co2":
+            events.append({"name": "SCD4x", "ph": "C", "ts": ts, "pid": 1,
+                           "args": {"temperature": frame["temperature"], "humidity": frame["humidity"]}})
+            events.append({"name": "co2", "ph": "C", "ts": ts, "pid": 1, "args": {"ppm": frame["co2"]}})
+        elif frame["type"] == "edge":
+            events.append({"name": "GPIO%d" % frame["pin"], "ph": "C", "ts": ts, "pid": 1,
+                           "args": {"level": frame["level"]}})
+        else:
+            events.append({"name": frame["topic"], "cat": frame["type"], "ph": "i", "s": "t", "ts": ts, "pid": 1,
+                           "tid": 2 if frame["type"] == "mqtt_in" else 3, "args": {"length": frame["length"]}})
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port to read from")
+    source.add_argument("--input", help="raw capture file")
+    parser.add_argument("--baud", type=int, default=921600, help="SERIAL_TRACE_RATE of the firmware")
+    parser.add_argument("--csv", help="write the frames as CSV, - for stdout")
+    parser.add_argument("--perfetto", help="write a Chrome JSON trace")
+    args = parser.parse_args()
+
+    decoder = Decoder()
+    frames = []
+    columns = ["sequence", "time_us", "type", "duration_us", "temperature", "humidity", "pressure",
+               "gas_resistance", "co2", "pin", "level", "topic", "length"]
+    csv_file = None
+    writer = None
+    if args.csv:
+        csv_file = sys.stdout if args.csv == "-" else open(args.csv, "w", newline="")
+        writer = csv.DictWriter(csv_file, columns, extrasaction="ignore")
+        writer.writeheader()
+    for chunk in read_source(args):
+        for frame in decoder.feed(chunk):
+            if writer:
+                writer.writerow(frame)
+            if args.perfetto:
+                frames.append(frame)
+    if csv_file and csv_file is not sys.stdout:
+        csv_file.close()
+    if args.perfetto:
+        with open(args.perfetto, "w") as trace:
+            json.dump({"traceEvents": perfetto_events(frames), "displayTimeUnit": "ms"}, trace)
+    print("lost frames: %d, CRC errors: %d" % (decoder.lost, decoder.crc_errors), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()